@@ -16,9 +16,23 @@
 #include <algorithm>
 #include "board.h"
 #include "action.h"
+#include "bitboard.h"
+#include "book.h"
+#include "arena.h"
+#include "numa.h"
+#include "fastmath.h"
+#include "transposition.h"
+#include <thread>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <array>
+#include <cstring>
+#include <cstdio>
 #include <fstream>
 #include <cstdlib>
 #include <ctime>
+#include <sys/wait.h>
 #include <map>
 
 class agent {
@@ -36,6 +50,8 @@ public:
 	virtual void close_episode(const std::string& flag = "") {}
 	virtual action take_action(const board& b) { return action(); }
 	virtual bool check_for_win(const board& b) { return false; }
+	virtual void warmup() {} // prepare for the first move, e.g., fault in the memory and warm up the caches
+	virtual bool forks() const { return false; } // whether it forks to search, which a process with other threads must not do
 
 public:
 	virtual std::string property(const std::string& key) const { return meta.at(key); }
@@ -71,7 +87,7 @@ public:
 
 protected:
 	std::default_random_engine engine;
-	float c;
+	float c = 1.41421356f; // the exploration constant
 	bool random_player = false;
 };
 
@@ -108,24 +124,197 @@ private:
 	board::piece_type who;
 };
 
+/**
+ * greedy player for both side
+ * put the legal piece that maximizes the mobility difference after one ply,
+ * i.e., the number of own legal moves minus the number of opponent legal moves
+ * ties are broken by the lowest position, so the player is deterministic
+ */
+class greedy_player : public agent {
+public:
+	greedy_player(const std::string& args = "") : agent("name=greedy role=unknown " + args),
+		who(board::empty) {
+		if (name().find_first_of("[]():; ") != std::string::npos)
+			throw std::invalid_argument("invalid name: " + name());
+		if (role() == "black") who = board::black;
+		if (role() == "white") who = board::white;
+		if (who == board::empty)
+			throw std::invalid_argument("invalid role: " + role());
+	}
+
+	virtual action take_action(const board& state) {
+		bitboard before(state);
+		action best_move = action();
+		int best_mobility = -board::size_x * board::size_y - 1;
+		for (bitboard::mask moves = before.legal(who); moves; moves &= moves - 1) {
+			int i = bitboard::lowest(moves);
+			bitboard after = before;
+			if (after.place(board::point(i), who) != board::legal) continue;
+			int mobility = bitboard::count(after.legal(who)) - bitboard::count(after.legal(3u - who));
+			if (mobility > best_mobility) {
+				best_mobility = mobility;
+				best_move = action::place(i, who);
+			}
+		}
+		return best_move;
+	}
+
+private:
+	board::piece_type who;
+};
+
+/**
+ * factory for creating the player specified by the "search" argument, e.g., "search=MCTS"
+ * the MCTS player is created if no search is specified
+ */
+class agent_factory {
+public:
+	typedef agent* (*creator)(const std::string& args);
+
+	static agent* create(const std::string& args) {
+		std::string search = argument(args, "search", "MCTS");
+		auto entry = entries().find(search);
+		if (entry == entries().end())
+			throw std::invalid_argument("invalid search: " + search);
+		return entry->second(args);
+	}
+
+	/**
+	 * the value of a key in the arguments, where the last one takes effect as in agent
+	 */
+	static std::string argument(const std::string& args, const std::string& key, const std::string& value = "") {
+		std::string res = value;
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; ) {
+			if (pair.find(key + "=") == 0) res = pair.substr(key.size() + 1);
+		}
+		return res;
+	}
+
+protected:
+	template<typename type>
+	static agent* create_as(const std::string& args) { return new type(args); }
+
+	typedef std::map<std::string, creator> registry;
+	static registry& entries() { static registry m; return m; }
+	static __attribute__((constructor)) void init();
+};
+
 struct v{
 	int total = 0;
 	int win = 0;
 };
 
+/**
+ * node of the search tree, which is stored in an arena and refers other nodes by indices
+ * the children of a node are allocated consecutively
+ */
 struct node{
 	int total = 0;
 	int win = 0;
-	node* parent = NULL;
-	std::vector<node*> children;
+	uint32_t parent = -1u;
+	uint32_t child = 0; // index of the first child
+	uint32_t children = 0; // number of children
+	unsigned code = -1u; // the code of the placing action
+	float prior = 0; // the heuristic value of the action
+	float prior_sum = 0; // the sum of the priors of the children
+	float minimax = 0; // the minimax value for the player who moved into it, with the minimax backup
+	uint64_t key = 0; // the hash of the state, if there is a transposition table
 	board state;
-	action::place move;
+
+	action::place move() const { return action(code); }
+};
+
+/**
+ * the terms of the visits of a parent, which are shared by all its children and computed once per selection step
+ */
+struct parent_terms {
+	float log;
+	float sqrt;
+	float sqrt_log;
+	parent_terms(uint32_t n) : log(fast_math::log(n)), sqrt(fast_math::sqrt(n)), sqrt_log(fast_math::sqrt_log(n)) {}
+};
+
+/**
+ * selection policies of MCTS, where value() scores a child by its statistics (win, total), the visits of its parent,
+ * its heuristic prior, its share of the priors among the siblings, and the exploration constant c
+ *  rave: the statistics are of the move (shared by all the nodes of the same move), otherwise of the node
+ *  visit_first: an unvisited child is selected before any other
+ */
+struct UCT_selection {
+	static constexpr bool rave = false;
+	static constexpr bool visit_first = true;
+	static float value(int win, int total, const parent_terms& parent, float prior, float share, float c) {
+		return float(win) / total + c * parent.sqrt_log * fast_math::inv_sqrt(total) + prior;
+	}
+};
+
+struct UCT_RAVE_selection {
+	static constexpr bool rave = true;
+	static constexpr bool visit_first = true;
+	static float value(int win, int total, const parent_terms& parent, float prior, float share, float c) {
+		return float(win) / total + c * parent.sqrt_log * fast_math::inv_sqrt(total) + prior;
+	}
+};
+
+struct UCB1_tuned_selection {
+	static constexpr bool rave = false;
+	static constexpr bool visit_first = true;
+	static float value(int win, int total, const parent_terms& parent, float prior, float share, float c) {
+		float mean = float(win) / total;
+		float deviation = parent.sqrt_log * fast_math::inv_sqrt(total); // sqrt(log(n) / total)
+		float variance = mean - mean * mean + float(M_SQRT2) * deviation;
+		return mean + deviation * std::sqrt(std::min(0.25f, variance)) + prior;
+	}
 };
 
+struct PUCT_selection {
+	static constexpr bool rave = false;
+	static constexpr bool visit_first = false;
+	static float value(int win, int total, const parent_terms& parent, float prior, float share, float c) {
+		float mean = total ? float(win) / total : 0;
+		return mean + c * share * parent.sqrt / (1 + total);
+	}
+};
+
+/**
+ * backup policies of MCTS, where update() is called with the statistics of the move for each node
+ * on the path from the simulated node up to the root (excluding), and the result for the player at the root
+ */
+struct playout_backup {
+	static constexpr bool minimax = false; // whether the minimax value of a node is blended into its win rate
+	static void update(arena<node>& tree, node& cur, v& stat, int result) {
+		stat.total++;
+		stat.win += result;
+		cur.total++;
+		cur.win += result;
+	}
+};
+
+/**
+ * implicit minimax backup, which also backs up the static evaluations of the leaves in the negamax form,
+ * i.e., the minimax value of an expanded node is 1 minus the best minimax value of its children
+ */
+struct minimax_backup {
+	static constexpr bool minimax = true;
+	static void update(arena<node>& tree, node& cur, v& stat, int result) {
+		playout_backup::update(tree, cur, stat, result);
+		if (cur.children == 0) return; // a leaf keeps its static evaluation
+		float best = 0;
+		for (uint32_t i = 0; i < cur.children; i++) best = std::max(best, tree[cur.child + i].minimax);
+		cur.minimax = 1 - best;
+	}
+};
+
+/**
+ * base of the MCTS players, where the search loop is implemented by MCTS_variant for each combination of policies
+ */
 class MCTS_player : public random_agent {
 public:
 	MCTS_player(const std::string& args = "") : random_agent("name=random role=unknown " + args),
-		space(board::size_x * board::size_y), who(board::empty) ,root(NULL){
+		space(board::size_x * board::size_y), who(board::empty) ,root(NULL),
+		tree(meta.find("tree_size") != meta.end() ? size_t(meta["tree_size"]) : 1 << 22,
+		     meta.find("hugepage") != meta.end() && int(meta["hugepage"])){
 		if (name().find_first_of("[]():; ") != std::string::npos)
 			throw std::invalid_argument("invalid name: " + name());
 		if (role() == "black") who = board::black;
@@ -134,30 +323,87 @@ public:
 			throw std::invalid_argument("invalid role: " + role());
 		for (size_t i = 0; i < space.size(); i++)
 			space[i] = action::place(i, who);
+		if (meta.find("timeout") != meta.end())
+			timeout = float(meta["timeout"]);
+		if (meta.find("simulation") != meta.end())
+			simulation_count = size_t(meta["simulation"]);
+		if (meta.find("resign") != meta.end())
+			resign_threshold = float(meta["resign"]);
+		if (meta.find("resign_moves") != meta.end())
+			resign_moves = int(meta["resign_moves"]);
+		if (meta.find("resign_playout") != meta.end())
+			resign_playout = float(meta["resign_playout"]);
+		if (meta.find("solve") != meta.end())
+			solve = int(meta["solve"]);
+		if (meta.find("checkpoint") != meta.end())
+			checkpoint_interval = float(meta["checkpoint"]);
+		if (meta.find("book_weight") != meta.end())
+			book_weight = int(meta["book_weight"]);
+		if (meta.find("book") != meta.end())
+			book.reset(new learning_book(meta["book"], meta.find("book_size") != meta.end() ? size_t(meta["book_size"]) : 1 << 20));
+		if (meta.find("widen") != meta.end())
+			widen = float(meta["widen"]);
+		if (meta.find("widen_alpha") != meta.end())
+			widen_alpha = float(meta["widen_alpha"]);
+		if (meta.find("root") != meta.end())
+			root_policy = std::string(meta["root"]);
+		if (meta.find("halving_m") != meta.end())
+			halving_m = size_t(meta["halving_m"]);
+		if (meta.find("relayout") != meta.end())
+			relayout_interval = size_t(meta["relayout"]);
+		if (meta.find("pin") != meta.end())
+			pin = std::string(meta["pin"]);
+		if (meta.find("warmup") != meta.end())
+			warmup_time = float(meta["warmup"]);
+		if (meta.find("warmup_nodes") != meta.end())
+			warmup_nodes = size_t(meta["warmup_nodes"]);
+		if (meta.find("processes") != meta.end())
+			processes = size_t(meta["processes"]);
+		if (meta.find("alpha") != meta.end())
+			alpha = float(meta["alpha"]);
+		if (meta.find("deterministic") != meta.end())
+			deterministic = int(meta["deterministic"]);
+		if (deterministic && processes > 1)
+			throw std::invalid_argument("deterministic search with multiple processes");
+		if (processes > 1) {
+			shared.reset(new transposition_table(meta.find("tt_size") != meta.end() ? size_t(meta["tt_size"]) : 1 << 20,
+			                                     meta.find("hugepage") != meta.end() && int(meta["hugepage"])));
+			table = shared.get();
+		}
 
 		who_cpy = who;
-	}
-
-	float UCT(node* cur){
-		float win_rate = (float) cur->win / (float) cur->total;
-		float exploitation = sqrt(log(cur->parent->total) / (float) cur->total);
-		float uct = win_rate + c * exploitation;
 
-		return uct; 
+		size_t threads = meta.find("threads") != meta.end() ? size_t(meta["threads"]) : 1;
+		if (deterministic && !simulation_count)
+			throw std::invalid_argument("deterministic search without a simulation count");
+		if (root_policy == "halving" && (threads > 1 || processes > 1)) // only the halving of this thread would decide
+			throw std::invalid_argument("sequential halving with multiple threads or processes");
+		for (size_t i = 1; i < threads; i++)
+			helpers.emplace_back(dynamic_cast<MCTS_player*>(agent_factory::create(helper_args(i, threads))));
+		simulation_count = simulation_share(0, threads);
 	}
 
-	float UCT_RAVE(node* cur){
-		float win_rate = (float) action2v[cur->move].win / (float) action2v[cur->move].total;
-		float exploitation = -1;
-		if(cur->parent == root) exploitation = sqrt(log(cur->parent->total) / (float) action2v[cur->move].total);
-		else exploitation = sqrt(log(action2v[cur->parent->move].total) / (float) action2v[cur->move].total);
-		float uct = win_rate + c * exploitation;
-
-		return uct; 
+	/**
+	 * the arguments of the i-th helper, which only searches, with its own seed and share of the simulations
+	 */
+	std::string helper_args(size_t i, size_t threads) {
+		std::stringstream args;
+		for (auto& pair : meta) {
+			if (pair.first == "threads" || pair.first == "seed" || pair.first == "simulation" || pair.first == "book"
+			        || pair.first == "processes") continue;
+			args << pair.first << '=' << std::string(pair.second) << ' ';
+		}
+		unsigned seed = meta.find("seed") != meta.end() ? unsigned(meta["seed"]) : 1;
+		args << "seed=" << (seed + i) << ' ' << "simulation=" << simulation_share(i, threads);
+		return args.str();
 	}
 
-	float get_value(node* cur){
-		return UCT_RAVE(cur);
+	/**
+	 * the simulations of the i-th thread, at least 1 if there is a limit, since 0 would mean no limit
+	 */
+	size_t simulation_share(size_t i, size_t threads) const {
+		if (!simulation_count) return 0;
+		return std::max<size_t>(simulation_count / threads + (i < simulation_count % threads ? 1 : 0), 1);
 	}
 
 	std::vector<int> count_around(node* child, node* cur){
@@ -167,39 +413,40 @@ public:
 		board after_right = cur->state;
 
 		std::vector<int> counts(5); // 0: empty_count, 1: up_same_color_count, 2: down, 3: left, 4: right
+		action::place move = child->move();
 
-		if(child->move.apply_up(after_up, who) == board::legal) {
+		if(move.apply_up(after_up, who) == board::legal) {
 			counts[0]++;
-			board::reward r1 = child->move.apply2(after_up, who, -1, -1);
-			board::reward r2 = child->move.apply2(after_up, who, -1, +1);
-			board::reward r3 = child->move.apply2(after_up, who, -2, 0);
+			board::reward r1 = move.apply2(after_up, who, -1, -1);
+			board::reward r2 = move.apply2(after_up, who, -1, +1);
+			board::reward r3 = move.apply2(after_up, who, -2, 0);
 			if(r1 == board::illegal_same_color || r1 == board::illegal_out_of_range) counts[1]++;
 			if(r2 == board::illegal_same_color || r2 == board::illegal_out_of_range) counts[1]++;
 			if(r3 == board::illegal_same_color || r3 == board::illegal_out_of_range) counts[1]++;
 		}
-		if(child->move.apply_down(after_down, who) == board::legal) {
+		if(move.apply_down(after_down, who) == board::legal) {
 			counts[0]++;
-			board::reward r1 = child->move.apply2(after_down, who, +1, -1);
-			board::reward r2 = child->move.apply2(after_down, who, +1, +1);
-			board::reward r3 = child->move.apply2(after_down, who, +2, 0);
+			board::reward r1 = move.apply2(after_down, who, +1, -1);
+			board::reward r2 = move.apply2(after_down, who, +1, +1);
+			board::reward r3 = move.apply2(after_down, who, +2, 0);
 			if(r1 == board::illegal_same_color || r1 == board::illegal_out_of_range) counts[2]++;
 			if(r2 == board::illegal_same_color || r2 == board::illegal_out_of_range) counts[2]++;
 			if(r3 == board::illegal_same_color || r3 == board::illegal_out_of_range) counts[2]++;
 		}
-		if(child->move.apply_left(after_left, who) == board::legal) {
+		if(move.apply_left(after_left, who) == board::legal) {
 			counts[0]++;
-			board::reward r1 = child->move.apply2(after_left, who, -1, -1);
-			board::reward r2 = child->move.apply2(after_left, who, +1, -1);
-			board::reward r3 = child->move.apply2(after_left, who, 0, -2);
+			board::reward r1 = move.apply2(after_left, who, -1, -1);
+			board::reward r2 = move.apply2(after_left, who, +1, -1);
+			board::reward r3 = move.apply2(after_left, who, 0, -2);
 			if(r1 == board::illegal_same_color || r1 == board::illegal_out_of_range) counts[3]++;
 			if(r2 == board::illegal_same_color || r2 == board::illegal_out_of_range) counts[3]++;
 			if(r3 == board::illegal_same_color || r3 == board::illegal_out_of_range) counts[3]++;
 		}
-		if(child->move.apply_right(after_right, who) == board::legal) {
+		if(move.apply_right(after_right, who) == board::legal) {
 			counts[0]++;
-			board::reward r1 = child->move.apply2(after_right, who, -1, +1);
-			board::reward r2 = child->move.apply2(after_right, who, +1, +1);
-			board::reward r3 = child->move.apply2(after_right, who, 0, +2);
+			board::reward r1 = move.apply2(after_right, who, -1, +1);
+			board::reward r2 = move.apply2(after_right, who, +1, +1);
+			board::reward r3 = move.apply2(after_right, who, 0, +2);
 			if(r1 == board::illegal_same_color || r1 == board::illegal_out_of_range) counts[4]++;
 			if(r2 == board::illegal_same_color || r2 == board::illegal_out_of_range) counts[4]++;
 			if(r3 == board::illegal_same_color || r3 == board::illegal_out_of_range) counts[4]++;
@@ -208,6 +455,39 @@ public:
 		return counts;
 	}
 
+	/**
+	 * the heuristic prior of a child, which depends only on the state of its parent and is computed once at expansion
+	 */
+	float heuristic(node* child, node* cur){
+		std::vector<int> counts = count_around(child, cur);
+		float weights[4] = {0.0, 12.0, 25.0, 100.0};
+
+		float value = counts[0] * 2.0;
+		for(int i = 1 ; i < 4 ; i++) value += weights[counts[i]] * counts[i];
+		return value;
+	}
+
+	/**
+	 * the static evaluation of a state for the player who has just moved, by the difference of the legal moves of both sides,
+	 * where the opponent loses if it has no legal move
+	 */
+	static float mobility(const board& state, unsigned who) {
+		bitboard b(state);
+		int own = bitboard::count(b.legal(who)), opp = bitboard::count(b.legal(3 - who));
+		if (opp == 0) return 1;
+		return 1 / (1 + std::exp((opp - own) * 0.25f));
+	}
+
+	/**
+	 * the number of children to be considered by progressive widening, k(n) = ceil(widen * (n + 1) ^ widen_alpha),
+	 * where the children are sorted by the prior; all the children are considered if widening is disabled
+	 */
+	size_t widened(const node* cur) const {
+		if (!widen) return cur->children;
+		size_t k = std::ceil(widen * std::pow(cur->total + 1, widen_alpha));
+		return std::min<size_t>(std::max<size_t>(k, 1), cur->children);
+	}
+
 	void change_player() {
 		if(who == board::black) who = board::white;
 		else if(who == board::white) who = board::black;
@@ -215,58 +495,70 @@ public:
 		return;
 	}
 
-	node* select(){
-		node* cur = root;
-		who = who_cpy;
-
-		while(cur->children.size() != 0){
-			std::shuffle(cur->children.begin(), cur->children.end(), engine);
-			float best_uct = -1;
-			node* best_child = NULL;
-
-			for(node* child : cur->children){
-				if(action2v[child->move].total == 0){
-					best_child = child;
-					break;
-				}
-
-				std::vector<int> counts = count_around(child, cur);
-				float weights[4] = {0.0, 12.0, 25.0, 100.0};
-
-				float uct = get_value(child) + counts[0] * 2.0;
-				for(int i = 1 ; i < 4 ; i++) uct += weights[counts[i]] * counts[i];
-
-				if(uct > best_uct){
-					uct = best_uct;
-					best_child = child;
-				}
-			}
-
-			cur = best_child;
-			change_player();
-		}
-
-		return cur;
-	}
-	
 	void expand(node* leaf) {
+		if (tree.size() + space.size() > tree.capacity()) return; // the tree is full
+		leaf->child = tree.size();
 		for (const action::place& move : space) {
 			board after = leaf->state;
 			if (move.apply(after, who) == board::legal){
-				node* child = new node;
+				node* child = tree.allocate();
 				child->state = after;
-				leaf->children.push_back(child);
-				child->parent = leaf;
-				child->move = move;
+				child->parent = tree.index(leaf);
+				child->code = move;
+				child->prior = heuristic(child, leaf);
+				if (evaluate) child->minimax = mobility(after, who);
+				leaf->prior_sum += child->prior;
+				leaf->children++;
+				if (book && leaf == root) seed_from_book(child);
+				if (table) seed_from_table(child);
 			}
 		}
+		if (evaluate && leaf->children == 0) leaf->minimax = 1; // the player to move has lost
+		if (widen) {
+			std::sort(&tree[leaf->child], &tree[leaf->child] + leaf->children,
+			          [](const node& a, const node& b) { return a.prior > b.prior; });
+		}
 
 		return;
 	}
 
+	/**
+	 * seed the statistics of a node from the book, scaled down to at most book_weight visits
+	 * the seeds of the moves are kept only while the tree exists, so they do not pile up in action2v over the episode
+	 */
+	void seed_from_book(node* cur) {
+		const learning_book::entry* record = book->find(cur->state.canonical_hash());
+		uint32_t visits = record ? record->total.load(std::memory_order_relaxed) : 0;
+		if (!visits) return;
+		int total = std::min<uint32_t>(visits, book_weight);
+		float black_rate = float(std::min(record->win.load(std::memory_order_relaxed), visits)) / visits;
+		int win = std::lround((who_cpy == board::black ? black_rate : 1 - black_rate) * total);
+		cur->total += total;
+		cur->win += win;
+		if (cur != root) {
+			stat(cur).total += total;
+			stat(cur).win += win;
+			book_seeds.push_back({ cur->code & 0xffff, total, win });
+		}
+	}
+
+	/**
+	 * seed the statistics of a node and its move from the transposition table, i.e., the visits of the other processes
+	 * so far in this search, so that they also steer the selection by the statistics of the moves (e.g., UCT_RAVE)
+	 */
+	void seed_from_table(node* cur) {
+		cur->key = cur->state.hash();
+		uint32_t total, win;
+		if (!table->find(cur->key, total, win)) return;
+		cur->total += total;
+		cur->win += win;
+		stat(cur).total += total;
+		stat(cur).win += win;
+	}
+
 	node* random_child(node* leaf){
-		std::shuffle(leaf->children.begin(), leaf->children.end(), engine);
-		node* child = leaf->children[0];		
+		size_t i = std::uniform_int_distribution<size_t>(0, widened(leaf) - 1)(engine);
+		node* child = &tree[leaf->child + i];
 		return child;
 	}
 
@@ -301,94 +593,506 @@ public:
 				board after = cur_state;
 				if (move.apply(after, who) == board::legal){
 					cur_state = after;
+					profile.playout_moves++;
 					break;
 				}
 			}
 
 			change_player();
 		}
+		profile.playouts++;
 
 		who = who_cpy;
 		if(winner == who) return 1;
 		else return 0;
 	}
 
-	void backpropagate(node* child, int result){
-		node* cur = child;
+	/**
+	 * pin the calling thread as the i-th search thread, and prefer its NUMA node for the arena
+	 * the arena is bound before it is first touched, which also places it by the first-touch policy
+	 */
+	void place_thread(size_t i){
+		if (pin.empty() || pin == "none") return;
+		numa::pin(numa::cpus_of(i, pin));
+		if (!bound) bound = numa::bind(tree.data(), tree.reserved(), numa::node_of(i).id);
+		if (bound) bound_node = numa::node_of(i).id;
+	}
 
-		while(cur != root){
-			action2v[cur->move].total++;
-			action2v[cur->move].win += result;
-			cur = cur->parent;
+	/**
+	 * root parallel search, where each helper searches its own tree on its own thread
+	 * the helpers start from the statistics of this player, and their new statistics are merged back afterwards
+	 */
+	void parallel_mcts(float limit){
+		std::array<v, board::size_x * board::size_y> start = action2v;
+		thread_mcts(limit, start);
+		merge_helpers(start);
+	}
+
+	/**
+	 * search on this thread and on the helper threads, where the helpers start from the given statistics of the moves
+	 */
+	void thread_mcts(float limit, const std::array<v, board::size_x * board::size_y>& start){
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < helpers.size(); i++) {
+			MCTS_player* helper = helpers[i].get();
+			helper->action2v = start;
+			helper->profile = search_profile();
+			threads.emplace_back([this, helper, i, limit]() {
+				helper->place_thread(i + 1);
+				helper->root = helper->tree.allocate();
+				helper->root->state = root->state;
+				helper->mcts(limit);
+			});
 		}
+		place_thread(0);
+		mcts(limit);
+		for (std::thread& thread : threads) thread.join();
+	}
 
-		root->total++;
-		root->win += result;
+	/**
+	 * merge the new statistics of the helpers back in the order of the helpers, so the merged statistics do not depend
+	 * on which thread finishes first; the children of the roots are matched by their moves (since their order may differ),
+	 * and a child takes the minimax value of the tree that has visited it the most
+	 */
+	void merge_helpers(const std::array<v, board::size_x * board::size_y>& start){
+		std::array<node*, board::size_x * board::size_y> children;
+		children.fill(nullptr);
+		for (uint32_t i = 0; i < root->children; i++) children[tree[root->child + i].code & 0xffff] = &tree[root->child + i];
 
-		winner = board::piece_type();
+		for (auto& helper : helpers) {
+			root->total += helper->root->total;
+			root->win += helper->root->win;
+			for (uint32_t i = 0; i < helper->root->children; i++) {
+				const node& from = helper->tree[helper->root->child + i];
+				node* to = children[from.code & 0xffff];
+				if (!to) continue; // not expanded by this player, e.g., the tree is full
+				if (from.total > to->total) to->minimax = from.minimax;
+				to->total += from.total;
+				to->win += from.win;
+			}
+			for (size_t i = 0; i < action2v.size(); i++) {
+				action2v[i].total += helper->action2v[i].total - start[i].total;
+				action2v[i].win += helper->action2v[i].win - start[i].win;
+			}
+			profile.playouts += helper->profile.playouts;
+			profile.playout_moves += helper->profile.playout_moves;
+			helper->delete_tree();
+		}
 		return;
 	}
 
-	void mcts(){
-		const clock_t limit_time = use_time[ply] * CLOCKS_PER_SEC;
-		const clock_t start_time = clock();
+	/**
+	 * multi-process search led by this process, where the workers are forked with the current tree,
+	 * search with their own seeds (on a single thread each), and add their visits to the transposition table;
+	 * the visits of the children of the root by the other processes are merged back from the table afterwards
+	 * the helper threads of the leader do not use the table, since their visits are merged by parallel_mcts
+	 * note that the simulation count (if any) is per process, and that the process must not have any other thread
+	 * (than the helpers, which are not running) when it forks, so hosts with threads of their own refuse processes > 1
+	 */
+	void process_mcts(float limit){
+		table->clear(); // only the visits of this search, which are not merged yet
+		std::array<v, board::size_x * board::size_y> start = action2v;
+		std::vector<pid_t> workers;
+		for (size_t i = 1; i < processes; i++) {
+			pid_t pid = ::fork();
+			if (pid == 0) { // worker
+				unsigned seed = meta.find("seed") != meta.end() ? unsigned(meta["seed"]) : 1;
+				engine.seed(seed + i * 7919 + ply);
+				place_thread(i * (helpers.size() + 1));
+				mcts(limit);
+				::_exit(0);
+			}
+			if (pid > 0) workers.push_back(pid);
+		}
+		thread_mcts(limit, start);
+		for (pid_t pid : workers) ::waitpid(pid, nullptr, 0);
 
-		while(1){
-			node* leaf = select();
-			expand(leaf);
+		// the visits of this process in the table are of this thread only, so the helpers are merged after the table
 
-			if(leaf->children.empty()){
-				int result = simulation(leaf);
-				backpropagate(leaf, result);
-				clock_t end_time = clock();
-				if(end_time - start_time >= limit_time) break;
-				continue;
+		for (size_t i = 0; i < root->children; i++) {
+			node* child = &tree[root->child + i];
+			uint32_t total, win;
+			if (!table->find(child->key, total, win) || int(total) <= child->total) continue;
+			int more_total = total - child->total, more_win = win - child->win;
+			child->total += more_total;
+			child->win += more_win;
+			stat(child).total += more_total;
+			stat(child).win += more_win;
+			root->total += more_total;
+			root->win += more_win;
+		}
+		merge_helpers(start);
+	}
+
+	/**
+	 * search with all the threads and processes, and publish the profile of the search
+	 */
+	void parallel_search(float limit){
+		auto start = std::chrono::steady_clock::now();
+		profile = search_profile();
+		if (deterministic) reseed();
+		if (processes > 1) process_mcts(limit);
+		else parallel_mcts(limit);
+		publish_profile(std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	/**
+	 * publish the profile of the last search as the properties "playouts", "playout_length", "sims_per_sec", and
+	 * "instability" (the playouts of other processes are not counted), where a value that is not measured is empty,
+	 * e.g., the instability without two samples (such as by sequential halving, which does not sample)
+	 * a move decided without a search publishes an empty profile, so the properties are never left from another move
+	 */
+	void publish_profile(float sec){
+		notify("playouts=" + std::to_string(profile.playouts));
+		notify("playout_length=" + (profile.playouts ? std::to_string(float(profile.playout_moves) / profile.playouts) : ""));
+		notify("sims_per_sec=" + std::to_string(sec > 0 ? profile.playouts / sec : 0));
+		notify("instability=" + (profile.samples > 1 ? std::to_string(float(profile.changes) / (profile.samples - 1)) : ""));
+	}
+
+	/**
+	 * reset the random engine and the move order of the playouts of each search thread to a function of
+	 * the seed, the thread, and the state of the root, so that a search does not depend on the previous ones
+	 */
+	void reseed(){
+		unsigned seed = meta.find("seed") != meta.end() ? unsigned(meta["seed"]) : 1;
+		uint64_t hash = root->state.hash();
+		for (size_t i = 0; i <= helpers.size(); i++) {
+			MCTS_player& player = i ? *helpers[i - 1] : *this;
+			std::seed_seq seq = { seed, unsigned(i), unsigned(hash), unsigned(hash >> 32) };
+			player.engine.seed(seq);
+			for (size_t k = 0; k < player.space.size(); k++)
+				player.space[k] = action::place(k, player.who_cpy);
+		}
+	}
+
+	/**
+	 * sample the most visited child of the root, and count the samples where it is changed
+	 */
+	void sample_best(){
+		uint32_t best = -1u;
+		int most = -1;
+		for (uint32_t i = 0; i < root->children; i++) {
+			if (tree[root->child + i].total > most) {
+				most = tree[root->child + i].total;
+				best = i;
 			}
+		}
+		if (profile.samples++ && best != profile.best) profile.changes++;
+		profile.best = best;
+	}
 
-			node* child = random_child(leaf);
-			int result = simulation(child);
-			backpropagate(child, result);
+	/**
+	 * rewrite the tree into a fresh arena in depth-first order, where the subtrees of a node are laid out by its most
+	 * visited children first, so that descending the principal variation walks through memory mostly forward
+	 * the children of a node stay consecutive and in the same order
+	 */
+	void relayout(){
+		if (!root) return;
+		if (!spare) {
+			spare.reset(new arena<node>(tree.capacity(), tree.huge_pages()));
+			if (bound) numa::bind(spare->data(), spare->reserved(), bound_node);
+		}
+		spare->clear();
+		node* top = spare->allocate();
+		*top = *root;
+		uint32_t best = halving_best ? tree.index(halving_best) : -1u, best_to = -1u; // in the tree, and in the spare
 
-			clock_t end_time = clock();
-			if(end_time - start_time >= limit_time) break;
+		std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0 } }; // index in the tree, and in the spare
+		std::vector<uint32_t> order;
+		while (stack.size()) {
+			uint32_t from = stack.back().first, to = stack.back().second;
+			stack.pop_back();
+			const node& cur = tree[from];
+			if (from == best) best_to = to;
+			if (cur.children == 0) continue;
+
+			(*spare)[to].child = spare->size();
+			node* children = spare->allocate(cur.children);
+			order.clear();
+			for (uint32_t i = 0; i < cur.children; i++) {
+				children[i] = tree[cur.child + i];
+				children[i].parent = to;
+				order.push_back(i);
+			}
+			std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return children[a].total < children[b].total; });
+			for (uint32_t i : order) stack.emplace_back(cur.child + i, (*spare)[to].child + i); // the hottest is popped first
 		}
 
-		return;
+		tree.swap(*spare);
+		root = &tree[0];
+		halving_best = halving_best ? &tree[best_to] : NULL;
 	}
 
+	/**
+	 * the statistics of the move of a node, where the moves of this player have the same color
+	 */
+	v& stat(const node* cur) { return action2v[cur->code & 0xffff]; }
+
+	virtual void mcts(float limit) = 0;
+	virtual action best_action() = 0;
+
+	/**
+	 * create the MCTS player with the policies specified by "policy" and "backup"
+	 */
+	static agent* create(const std::string& args);
+
 	void delete_tree(){
-		node* cur = root;
-		while(root->children.size() != 0){
-			while(cur->children.size() != 0) cur = cur->children.back();
-			node* tmp = cur->parent;
-			tmp->children.pop_back();
-			delete(cur);
-			cur = tmp;
+		for (const tree_stat& seed : book_seeds) {
+			action2v[seed.code].total -= seed.total;
+			action2v[seed.code].win -= seed.win;
 		}
-
-		delete(root);
+		book_seeds.clear();
+		tree.clear();
+		root = NULL;
+		halving_best = NULL;
 		return;
 	}
 
-	virtual action take_action(const board& state) {
-		root = new node;
+	/**
+	 * save the search tree and the statistics to a binary file
+	 * the nodes are written page-aligned after the header, so that load_tree can map them back directly;
+	 * the file is written to a temporary path and then renamed, so a stopped process leaves the last checkpoint
+	 */
+	bool save_tree(const std::string& path) const {
+		if (!root) return false;
+		tree_header head;
+		std::memcpy(head.magic, "NOGOTREE", 8);
+		head.node_size = sizeof(node);
+		head.nodes = tree.size();
+		head.stats = action2v.size();
+		head.offset = sizeof(tree_header) + head.stats * sizeof(tree_stat);
+		head.offset = (head.offset + arena<node>::page_size() - 1) / arena<node>::page_size() * arena<node>::page_size();
+		head.state = root->state;
+		std::vector<tree_stat> stats;
+		for (size_t i = 0; i < action2v.size(); i++) stats.push_back({ action::place(i, who_cpy), action2v[i].total, action2v[i].win });
+
+		std::string temp = path + ".tmp";
+		std::ofstream out(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+		out.write(reinterpret_cast<const char*>(stats.data()), stats.size() * sizeof(tree_stat));
+		std::vector<char> padding(head.offset - sizeof(head) - stats.size() * sizeof(tree_stat));
+		out.write(padding.data(), padding.size());
+		out.write(reinterpret_cast<const char*>(tree.data()), tree.size() * sizeof(node));
+		out.close();
+		return out && std::rename(temp.c_str(), path.c_str()) == 0;
+	}
+
+	/**
+	 * load the search tree of the state saved by save_tree, return false if there is no such tree
+	 */
+	bool load_tree(const std::string& path, const board& state) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd == -1) return false;
+		tree_header head;
+		std::vector<tree_stat> stats;
+		bool valid = ::pread(fd, &head, sizeof(head), 0) == sizeof(head)
+			&& std::memcmp(head.magic, "NOGOTREE", 8) == 0 && head.node_size == sizeof(node) && head.nodes
+			&& head.state == state && head.state.info().who_take_turns == state.info().who_take_turns
+			&& head.stats == action2v.size(); // as saved by save_tree, so a corrupted count is not allocated
+		struct stat info;
+		valid = valid && ::fstat(fd, &info) == 0 && size_t(info.st_size) >= sizeof(head) + head.stats * sizeof(tree_stat);
+		if (valid) {
+			stats.resize(head.stats);
+			size_t bytes = stats.size() * sizeof(tree_stat);
+			valid = size_t(::pread(fd, stats.data(), bytes, sizeof(head))) == bytes && tree.map(fd, head.offset, head.nodes);
+		}
+		::close(fd);
+		for (size_t i = 0; valid && i < stats.size(); i++) valid = (stats[i].code & 0xffff) < action2v.size();
+		for (size_t i = 0; valid && i < head.nodes; i++) { // the file may be corrupted
+			const node& cur = tree[i];
+			valid = (cur.children == 0 || (cur.child > i && cur.child + uint64_t(cur.children) <= head.nodes))
+				&& (i == 0 || (cur.parent < i && (cur.code & 0xffff) < action2v.size()));
+		}
+		if (!valid) {
+			tree.clear();
+			return false;
+		}
+
+		root = &tree[0];
+		action2v.fill(v());
+		for (const tree_stat& stat : stats) {
+			action2v[stat.code & 0xffff].total = stat.total;
+			action2v[stat.code & 0xffff].win = stat.win;
+		}
+		return true;
+	}
+
+	/**
+	 * search the state for the given milliseconds and return the best action without playing it
+	 * the search resumes from the tree file if it holds the same state, and checkpoints to it periodically
+	 */
+	action analyze(const board& state, float millisec, const std::string& path) {
+		if (!load_tree(path, state)) {
+			tree.clear();
+			root = tree.allocate();
+			root->state = state;
+		}
+		checkpoint = path;
+		mcts(millisec / 1000);
+		checkpoint.clear();
+		if (relayout_interval) relayout();
+		save_tree(path);
+
+		action best_move = best_action();
+		delete_tree();
+		return best_move;
+	}
+
+	struct search_result {
+		action::place move; // or action() if there is no legal move
+		size_t visits; // of the root, including all the search threads
+		float win_rate; // of the root, for the side to move
+		float millisec;
+	};
+
+	/**
+	 * search the state within the given milliseconds and simulations (0 for no limit on either, but not both),
+	 * and return the best action without playing it; the statistics of the moves are kept as in take_action
+	 */
+	search_result search(const board& state, float millisec, size_t simulations) {
+		if (millisec <= 0 && simulations == 0) throw std::invalid_argument("search without a budget");
+		if (deterministic && simulations == 0) throw std::invalid_argument("deterministic search without a simulation count");
+		std::vector<std::pair<float, size_t>> budget;
+		for (size_t i = 0; i <= helpers.size(); i++) {
+			MCTS_player& player = i ? *helpers[i - 1] : *this;
+			budget.emplace_back(player.timeout, player.simulation_count);
+			player.timeout = std::max(millisec, 0.0f);
+			size_t share = simulations / (helpers.size() + 1) + (i < simulations % (helpers.size() + 1) ? 1 : 0);
+			player.simulation_count = simulations ? std::max<size_t>(share, 1) : 0;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		root = tree.allocate();
 		root->state = state;
-		mcts();
-		ply++;
+		if (book) seed_from_book(root);
+		parallel_search(millisec / 1000);
+		search_result res;
+		res.move = best_action();
+		res.visits = root->total;
+		res.win_rate = root->total ? float(root->win) / root->total : 0;
+		res.millisec = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		delete_tree();
 
-		action best_move = action();
-		float best_uct = -1;
-		for(node* child : root->children){
-			std::vector<int> counts = count_around(child, root);
-			float weights[4] = {0.0, 12.0, 25.0, 100.0};
+		for (size_t i = 0; i <= helpers.size(); i++) {
+			MCTS_player& player = i ? *helpers[i - 1] : *this;
+			player.timeout = budget[i].first;
+			player.simulation_count = budget[i].second;
+		}
+		return res;
+	}
 
-			float uct = get_value(child) + counts[0] * 2.0;
-			for(int i = 1 ; i < 4 ; i++) uct += weights[counts[i]] * counts[i];
+	virtual bool forks() const { return processes > 1; }
 
-			if(uct > best_uct){
-				best_uct = uct;
-				best_move = child->move;
+	/**
+	 * run a throw-away search of warmup_time milliseconds (on all the search threads, which also places them),
+	 * fault in the first warmup_nodes nodes of the trees, and build the lazy tables, so the first move
+	 * pays none of them; the statistics, the random engines, and the move order of the playouts are restored,
+	 * so the games are not changed (a deterministic search is not limited by time, so it runs a move's simulations)
+	 */
+	virtual void warmup() {
+		if (warmup_time <= 0) return;
+		numa::nodes();
+		std::vector<std::default_random_engine> engines;
+		std::vector<std::vector<action::place>> spaces;
+		size_t simulations = 0;
+		for (size_t i = 0; i <= helpers.size(); i++) {
+			MCTS_player& player = i ? *helpers[i - 1] : *this;
+			engines.push_back(player.engine);
+			spaces.push_back(player.space);
+			simulations += player.simulation_count;
+		}
+		std::array<v, board::size_x * board::size_y> stats = action2v;
+
+		board state;
+		if (who_cpy == board::white) // let it be the turn of this player
+			action::place(bitboard::lowest(bitboard(state).legal(board::black)), board::black).apply(state);
+		search(state, warmup_time, deterministic ? simulations : 0);
+
+		for (size_t i = 0; i <= helpers.size(); i++) {
+			MCTS_player& player = i ? *helpers[i - 1] : *this;
+			player.tree.prefault(warmup_nodes);
+			player.engine = engines[i];
+			player.space = spaces[i];
+		}
+		action2v = stats;
+	}
+
+	/**
+	 * prove the result of the state within two plies by the bitboard
+	 * return 1 and the winning move if there is a move leaving the opponent no legal move,
+	 * return -1 if every move (if any) has a reply leaving no legal move, or 0 if unknown
+	 */
+	int prove(const board& state, action::place& win_move) const {
+		bitboard before(state);
+		unsigned opp = 3u - who_cpy;
+		bool all_refuted = true;
+		for (bitboard::mask moves = before.legal(who_cpy); moves; moves &= moves - 1) {
+			int i = bitboard::lowest(moves);
+			bitboard after = before;
+			after.place(board::point(i), who_cpy);
+			bitboard::mask replies = after.legal(opp);
+			if (!replies) {
+				win_move = action::place(i, who_cpy);
+				return 1;
+			}
+			bool refuted = false;
+			for (; all_refuted && !refuted && replies; replies &= replies - 1) {
+				bitboard reply = after;
+				reply.place(board::point(bitboard::lowest(replies)), opp);
+				refuted = !reply.legal(who_cpy);
 			}
+			all_refuted &= refuted;
+		}
+		return all_refuted ? -1 : 0;
+	}
+
+	/**
+	 * a uniform fraction in [0, 1) hashed from the episode number (by splitmix64), which decides whether the episode is
+	 * played out fully; both players count the same episodes, so they play out the same ones, without using the engine
+	 */
+	static double playout_fraction(uint64_t episode) {
+		uint64_t z = (episode + 1) * 0x9e3779b97f4a7c15ull;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		z ^= z >> 31;
+		return double(z >> 11) / double(1ull << 53);
+	}
+
+	/**
+	 * resign if allowed in this episode, otherwise only remember it for calibration
+	 */
+	bool adjudicate_resign() {
+		if (!resignable && would_resign == -1) would_resign = ply;
+		return resignable;
+	}
+
+	virtual action take_action(const board& state) {
+		if (book) played.push_back(state.canonical_hash());
+
+		if (solve) {
+			profile = search_profile();
+			publish_profile(0); // in case the move is decided by the proof
+			action::place win_move;
+			int result = prove(state, win_move);
+			if (result > 0) { // no need to search for a proven win
+				ply++;
+				return win_move;
+			}
+			if (result < 0 && adjudicate_resign()) return action();
+		}
+
+		root = tree.allocate();
+		root->state = state;
+		if (book) seed_from_book(root);
+		parallel_search(timeout ? timeout / 1000 : use_time[std::min<size_t>(ply, use_time.size() - 1)]);
+		ply++;
+
+		action best_move = best_action();
+
+		if (resign_threshold > 0) { // resign if the win rate stays below the threshold
+			float win_rate = root->total ? float(root->win) / root->total : 1;
+			low_win_rate = win_rate < resign_threshold ? low_win_rate + 1 : 0;
+			if (low_win_rate >= resign_moves && adjudicate_resign()) best_move = action();
 		}
 
 		delete_tree();
@@ -398,23 +1102,97 @@ public:
 	virtual void open_episode(const std::string& flag = "") {
 		winner = board::piece_type();
 		root = NULL;
-		action2v.clear();
+		action2v.fill(v());
 		ply = 0;
+		low_win_rate = 0;
+		would_resign = -1;
+		resignable = resign_playout <= 0 || playout_fraction(episodes) >= resign_playout;
+		episodes++;
+		played.clear();
+		book_seeds.clear();
+		if (shared) shared->clear();
+		for (auto& helper : helpers) helper->open_episode(flag);
 		return;
 	}
 
 	virtual void close_episode(const std::string& flag = "") {
+		if (would_resign != -1 && flag == name()) { // played out but won, i.e., a false resignation
+			std::cerr << name() << " would have resigned a won game at ply " << would_resign << std::endl;
+		}
+		if (book) { // learn the result of the positions visited in this episode
+			bool black_win = (flag == name()) == (who_cpy == board::black);
+			for (uint64_t key : played) book->update(key, black_win);
+			played.clear();
+		}
 		return;
 	}
 
-private:
+protected:
+	struct tree_header {
+		char magic[8];
+		uint32_t node_size;
+		uint32_t stats;
+		uint64_t nodes;
+		uint64_t offset; // of the nodes in the file
+		board state; // of the root
+	};
+	struct tree_stat {
+		unsigned code;
+		int total;
+		int win;
+	};
+
 	std::vector<action::place> space;
 	board::piece_type who;
 	board::piece_type who_cpy;
 	board::piece_type winner;
 	node* root;
-	std::map<action::place, v> action2v;
+	arena<node> tree;
+	std::string checkpoint; // the tree file to be saved periodically
+	float checkpoint_interval = 60000; // milliseconds
+	std::vector<std::unique_ptr<MCTS_player>> helpers; // for the other search threads
+	float widen = 0; // the coefficient of progressive widening, or 0 to consider all the children
+	float widen_alpha = 0.4; // the exponent of progressive widening
+	std::string root_policy = "uct"; // selection at the root, "uct" or "halving" (with a simulation budget only)
+	size_t halving_m = 16; // the number of candidates of sequential halving
+	node* halving_best = NULL; // the result of sequential halving
+	std::string pin; // thread placement, "none", "cpu", or "node"
+	bool bound = false;
+	int bound_node = 0;
+	size_t relayout_interval = 0; // relayout the tree every this number of iterations, or 0 for never
+	std::unique_ptr<arena<node>> spare; // for relayout
+	float warmup_time = 0; // milliseconds of the throw-away search of warmup(), or 0 for no warm-up
+	size_t processes = 1; // the number of search processes
+	bool evaluate = false; // whether the children are evaluated statically at expansion, for the minimax backup
+	float alpha = 0.3; // the weight of the minimax value blended into the win rate in selection
+	bool deterministic = false; // search by the simulation count only, reseeded for each search, so runs are reproducible
+	std::unique_ptr<transposition_table> shared; // shared by the processes, owned by the leader
+	transposition_table* table = nullptr; // of the leader, not used by its helper threads
+	size_t warmup_nodes = 1 << 18; // the nodes faulted in by warmup()
+	std::array<v, board::size_x * board::size_y> action2v; // the statistics of each move, indexed by the position
+	struct search_profile {
+		size_t playouts = 0; // of all the search threads
+		size_t playout_moves = 0;
+		size_t samples = 0; // of the most visited child of the root, taken by the main thread only
+		size_t changes = 0;
+		uint32_t best = -1u;
+	} profile; // of the last search
+	static constexpr size_t sample_interval = 128; // the playouts between the samples of the most visited child
 	int ply;
+	float timeout = 0; // milliseconds per move, or 0 for the use_time schedule
+	size_t simulation_count = 0; // simulations per move, or 0 for no limit
+	float resign_threshold = 0; // resign if the root win rate is below it, or 0 for never
+	int resign_moves = 3; // for this number of consecutive moves
+	float resign_playout = 0; // fraction of episodes played out fully for calibration
+	int solve = 0; // whether to prove the result before searching
+	bool resignable = true;
+	uint64_t episodes = 0; // opened so far
+	int low_win_rate = 0;
+	int would_resign = -1;
+	std::unique_ptr<learning_book> book; // shared with other players through the file
+	int book_weight = 100; // the maximal visits seeded from the book
+	std::vector<uint64_t> played; // the positions to be learned at the end of the episode
+	std::vector<tree_stat> book_seeds; // the statistics of the moves seeded from the book, removed with the tree
 	/*std::vector<float> use_time = { 1.8, 1.8, 1.8, 1.8, 1.8, 1.8, 1.8, 1.75, 1.7, 1.65, 1.6,
 								   1.55, 1.5, 1.4, 1.3, 1.2, 1.1, 1.0, 1.0, 0.9, 0.8, 0.7, 
 								   0.6, 0.5, 0.45, 0.4, 0.35, 0.3, 0.25, 0.2, 0.2, 0.2, 0.2, 
@@ -422,4 +1200,210 @@ private:
 	std::vector<float> use_time = { 7.35, 7.4, 7.45, 7.5, 7.6, 7.7, 7.8, 7.9, 8, 8, 8.1, 8.2,
 									 8.3, 8.4, 8.5, 8.55, 8.6, 8.65, 8.65, 8.6, 8.55, 8.5, 8.4, 
 									 8.3, 8.2, 8.1, 8, 8, 7.9, 7.8, 7.7, 7.6, 7.5, 7.45, 7.4, 7.35 };
-};
\ No newline at end of file
+};
+
+/**
+ * MCTS player with the selection and backup policies fixed at compile time, so that they are inlined into the search loop
+ */
+template<typename selection, typename backup>
+class MCTS_variant : public MCTS_player {
+public:
+	MCTS_variant(const std::string& args = "") : MCTS_player(args) {
+		evaluate = backup::minimax;
+	}
+
+	/**
+	 * the visits of a node as the parent in the selection policy
+	 */
+	uint32_t parent_visits(node* cur){
+		if(selection::rave && cur != root) return stat(cur).total;
+		return cur->total;
+	}
+
+	bool unvisited(node* child){
+		if(!selection::visit_first) return false;
+		if(selection::rave) return stat(child).total == 0;
+		return child->total == 0;
+	}
+
+	float get_value(node* child, node* cur, const parent_terms& parent){
+		float share = cur->prior_sum > 0 ? child->prior / cur->prior_sum : 1.0f / cur->children;
+		int win = child->win, total = child->total;
+		if(selection::rave){
+			win = stat(child).win;
+			total = stat(child).total;
+		}
+		float value = selection::value(win, total, parent, child->prior, share, c);
+		if(backup::minimax){ // blend the minimax value into the win rate, both for the player at the root
+			float minimax = who == who_cpy ? child->minimax : 1 - child->minimax;
+			value += alpha * (minimax - (total ? float(win) / total : 0));
+		}
+		return value;
+	}
+
+	node* select(node* from){
+		node* cur = from;
+		who = who_cpy;
+		if(from != root) change_player(); // from a child of the root
+
+		while(cur->children != 0){
+			// visit the children from a random offset, since they cannot be shuffled in the arena
+			size_t children = widened(cur);
+			size_t offset = std::uniform_int_distribution<size_t>(0, children - 1)(engine);
+			parent_terms parent(parent_visits(cur));
+			float best_uct = -std::numeric_limits<float>::infinity();
+			node* best_child = &tree[cur->child + offset];
+
+			for(size_t i = 0; i < children; i++){
+				node* child = &tree[cur->child + (i + offset) % children];
+				if(unvisited(child)){
+					best_child = child;
+					break;
+				}
+
+				float uct = get_value(child, cur, parent);
+
+				if(uct > best_uct){
+					best_uct = uct;
+					best_child = child;
+				}
+			}
+
+			cur = best_child;
+			change_player();
+		}
+
+		return cur;
+	}
+
+	void backpropagate(node* child, int result){
+		node* cur = child;
+
+		while(cur != root){
+			backup::update(tree, *cur, stat(cur), result);
+			if(table) table->update(cur->key, result);
+			cur = &tree[cur->parent];
+		}
+
+		root->total++;
+		root->win += result;
+
+		winner = board::piece_type();
+		return;
+	}
+
+	void mcts(float limit){
+		// wall clock time, since clock() counts the time of all the search threads
+		typedef std::chrono::steady_clock wall;
+		const wall::duration limit_time = std::chrono::duration_cast<wall::duration>(std::chrono::duration<float>(limit));
+		const wall::time_point start_time = wall::now();
+		wall::time_point save_time = start_time;
+
+		if(root_policy == "halving" && simulation_count){
+			sequential_halving(simulation_count);
+			return;
+		}
+
+		for(size_t count = 1; ; count++){
+			playout(root);
+
+			if(count % sample_interval == 0) sample_best();
+			if(relayout_interval && count % relayout_interval == 0) relayout();
+
+			if(checkpoint.size() && wall::now() - save_time >= std::chrono::duration<float, std::milli>(checkpoint_interval)){
+				if(relayout_interval) relayout(); // so that the tree is mapped back in order
+				save_tree(checkpoint);
+				save_time = wall::now();
+			}
+
+			if(simulation_count && count >= simulation_count) break;
+			if(simulation_count && (!timeout || deterministic)) continue; // only limited by the simulation count
+			wall::time_point end_time = wall::now();
+			if(end_time - start_time >= limit_time) break;
+		}
+
+		return;
+	}
+
+	/**
+	 * one iteration of MCTS below the given node, which is either the root or a child of the root
+	 */
+	void playout(node* from){
+		node* leaf = select(from);
+		expand(leaf);
+
+		node* child = leaf->children == 0 ? leaf : random_child(leaf);
+		int result = simulation(child);
+		backpropagate(child, result);
+	}
+
+	/**
+	 * sequential halving at the root over the top halving_m children by the prior (ties are broken randomly)
+	 * the budget is split evenly into ceil(log2(m)) phases; in each phase every remaining candidate gets the same number of
+	 * simulations, searched by the usual selection below it, and then the better half by the mean value is kept
+	 */
+	void sequential_halving(size_t budget){
+		if(root->children == 0) expand(root);
+		if(root->children == 0) return;
+
+		std::vector<node*> candidates;
+		for(size_t i = 0; i < root->children; i++) candidates.push_back(&tree[root->child + i]);
+		std::shuffle(candidates.begin(), candidates.end(), engine);
+		std::stable_sort(candidates.begin(), candidates.end(), [](node* a, node* b) { return a->prior > b->prior; });
+		candidates.resize(std::min<size_t>(candidates.size(), std::max<size_t>(halving_m, 1)));
+
+		size_t phases = std::max<size_t>(std::ceil(std::log2(candidates.size())), 1);
+		for(size_t phase = 0; candidates.size() > 1; phase++){
+			size_t visits = std::max<size_t>(budget / (phases * candidates.size()), 1);
+			for(node* candidate : candidates){
+				for(size_t i = 0; i < visits; i++) playout(candidate);
+			}
+			std::stable_sort(candidates.begin(), candidates.end(), [](node* a, node* b) {
+				return (float) a->win / std::max(a->total, 1) > (float) b->win / std::max(b->total, 1);
+			});
+			candidates.resize((candidates.size() + 1) / 2);
+		}
+		halving_best = candidates.front();
+	}
+
+	action best_action(){
+		if(halving_best) return halving_best->move();
+
+		action best_move = action();
+		parent_terms parent(parent_visits(root));
+		float best_uct = -std::numeric_limits<float>::infinity();
+		for(size_t i = 0; i < root->children; i++){
+			node* child = &tree[root->child + i];
+			float uct = get_value(child, root, parent);
+
+			if(uct > best_uct){
+				best_uct = uct;
+				best_move = child->move();
+			}
+		}
+		return best_move;
+	}
+};
+
+template<typename backup>
+agent* create_MCTS_variant(const std::string& policy, const std::string& args) {
+	if (policy == "UCT") return new MCTS_variant<UCT_selection, backup>(args);
+	if (policy == "UCT_RAVE") return new MCTS_variant<UCT_RAVE_selection, backup>(args);
+	if (policy == "UCB1_tuned") return new MCTS_variant<UCB1_tuned_selection, backup>(args);
+	if (policy == "PUCT") return new MCTS_variant<PUCT_selection, backup>(args);
+	throw std::invalid_argument("invalid policy: " + policy);
+}
+
+inline agent* MCTS_player::create(const std::string& args) {
+	std::string policy = agent_factory::argument(args, "policy", "UCT_RAVE");
+	std::string backup = agent_factory::argument(args, "backup", "playout");
+	if (backup == "playout") return create_MCTS_variant<playout_backup>(policy, args);
+	if (backup == "minimax") return create_MCTS_variant<minimax_backup>(policy, args);
+	throw std::invalid_argument("invalid backup: " + backup);
+}
+
+inline void agent_factory::init() {
+	entries()["random"] = create_as<player>;
+	entries()["greedy"] = create_as<greedy_player>;
+	entries()["MCTS"] = MCTS_player::create;
+}
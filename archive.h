@@ -0,0 +1,467 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * archive.h: Compressed archive of game records
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "board.h"
+#include "bitboard.h"
+#include "episode.h"
+
+/**
+ * a range coder with carry propagation (as in LZMA), where a symbol is coded by its cumulative frequency
+ * the total frequency must be less than 2^16
+ */
+class range_encoder {
+public:
+	range_encoder(std::string& out) : out(out), low(0), range(-1u), cache(0), pending(1) {}
+
+	void encode(uint32_t cum, uint32_t freq, uint32_t total) {
+		range /= total;
+		low += uint64_t(cum) * range;
+		range *= freq;
+		while (range < (1u << 24)) {
+			range <<= 8;
+			shift();
+		}
+	}
+	void encode_bits(uint32_t value, unsigned bits) { // bits <= 16
+		encode(value & ((1u << bits) - 1), 1, 1u << bits);
+	}
+	void flush() {
+		for (int i = 0; i < 5; i++) shift();
+	}
+
+private:
+	void shift() {
+		if (uint32_t(low) < 0xff000000u || (low >> 32) != 0) {
+			uint8_t carry = low >> 32, temp = cache;
+			do {
+				out.push_back(char(uint8_t(temp + carry)));
+				temp = 0xff;
+			} while (--pending != 0);
+			cache = uint8_t(low >> 24);
+		}
+		pending++;
+		low = (low & 0x00ffffff) << 8;
+	}
+
+private:
+	std::string& out;
+	uint64_t low;
+	uint32_t range;
+	uint8_t cache;
+	uint64_t pending;
+};
+
+class range_decoder {
+public:
+	range_decoder(const char* first, const char* last) : at(first), end(last), code(0), range(-1u), past(0) {
+		for (int i = 0; i < 5; i++) code = (code << 8) | next();
+	}
+
+	/**
+	 * the cumulative frequency of the next symbol, which must be followed by decode()
+	 */
+	uint32_t frequency(uint32_t total) {
+		range /= total;
+		return std::min(code / range, total - 1);
+	}
+	void decode(uint32_t cum, uint32_t freq) {
+		code -= cum * range;
+		range *= freq;
+		while (range < (1u << 24)) {
+			code = (code << 8) | next();
+			range <<= 8;
+		}
+	}
+	uint32_t decode_bits(unsigned bits) {
+		uint32_t value = frequency(1u << bits);
+		decode(value, 1);
+		return value;
+	}
+
+	/**
+	 * whether more bytes have been read than the encoder can have written, i.e., the data is corrupted
+	 */
+	bool overrun() const { return past > 5; }
+
+private:
+	uint8_t next() {
+		if (at != end) return uint8_t(*at++);
+		past++;
+		return 0;
+	}
+
+private:
+	const char* at;
+	const char* end;
+	uint32_t code;
+	uint32_t range;
+	size_t past; // the bytes read beyond the end
+};
+
+/**
+ * an adaptive frequency model of n symbols
+ */
+class adaptive_model {
+public:
+	adaptive_model(size_t n = 2) : freq(n, 1), total(n) {}
+
+	void encode(range_encoder& enc, size_t s) {
+		uint32_t cum = 0;
+		for (size_t i = 0; i < s; i++) cum += freq[i];
+		enc.encode(cum, freq[s], total);
+		update(s);
+	}
+	size_t decode(range_decoder& dec) {
+		uint32_t target = dec.frequency(total), cum = 0;
+		size_t s = 0;
+		while (cum + freq[s] <= target) cum += freq[s++];
+		dec.decode(cum, freq[s]);
+		update(s);
+		return s;
+	}
+
+private:
+	void update(size_t s) {
+		freq[s] += step;
+		total += step;
+		if (total > limit) {
+			total = 0;
+			for (uint32_t& f : freq) total += (f = (f + 1) / 2);
+		}
+	}
+
+private:
+	static constexpr uint32_t step = 32;
+	static constexpr uint32_t limit = 1 << 15;
+	std::vector<uint32_t> freq;
+	uint32_t total;
+};
+
+/**
+ * the coding of episodes, where the models adapt to the episodes coded so far
+ *
+ * a move is coded as its index among the legal moves of the side to move (by bitboard::legal),
+ * with a model for each number of legal moves; the symbol after the legal moves ends the episode,
+ * and the next one escapes a move that is not the next legal move, which is then coded as is
+ */
+class archive_codec {
+public:
+	archive_codec() { reset(); }
+
+	void reset() {
+		moves.clear();
+		for (int n = 0; n <= board::size_x * board::size_y; n++) moves.emplace_back(n + 2);
+		times = adaptive_model(256);
+		numbers = adaptive_model(256);
+		chars = adaptive_model(256);
+		same_open = adaptive_model(2);
+		same_close = adaptive_model(2);
+		last = episode::meta();
+		last_close = episode::meta();
+	}
+
+	void encode(range_encoder& enc, const episode& ep) {
+		encode_tag(enc, ep.ep_open.tag, last.tag, same_open);
+		encode_number(enc, numbers, zigzag(ep.ep_open.when - last.when));
+		encode_tag(enc, ep.ep_close.tag, last_close.tag, same_close);
+		encode_number(enc, numbers, zigzag(ep.ep_close.when - ep.ep_open.when));
+		last = ep.ep_open;
+		last_close = ep.ep_close;
+
+		bitboard state;
+		for (const episode::move& mv : ep.ep_moves) {
+			unsigned who = state.take_turns();
+			bitboard::mask legal = state.legal(who);
+			int n = bitboard::count(legal);
+			int i = int16_t(mv.code << 2) >> 2;
+			unsigned color = mv.code >> 14;
+			if (color == who && i >= 0 && i < board::size_x * board::size_y && (legal & bitboard::bit(i))) {
+				moves[n].encode(enc, bitboard::count(legal & (bitboard::bit(i) - 1)));
+			} else {
+				moves[n].encode(enc, n + 1);
+				enc.encode_bits(mv.code, 16);
+			}
+			board::point p(i);
+			state.place(p.x, p.y, color);
+			encode_number(enc, times, mv.cost);
+		}
+		int n = bitboard::count(state.legal(state.take_turns()));
+		moves[n].encode(enc, n);
+	}
+
+	void decode(range_decoder& dec, episode& ep) {
+		ep = {};
+		ep.ep_open.tag = decode_tag(dec, last.tag, same_open);
+		ep.ep_open.when = last.when + unzigzag(decode_number(dec, numbers));
+		ep.ep_close.tag = decode_tag(dec, last_close.tag, same_close);
+		ep.ep_close.when = ep.ep_open.when + unzigzag(decode_number(dec, numbers));
+		last = ep.ep_open;
+		last_close = ep.ep_close;
+
+		bitboard state;
+		while (true) {
+			unsigned who = state.take_turns();
+			bitboard::mask legal = state.legal(who);
+			int n = bitboard::count(legal);
+			size_t s = moves[n].decode(dec);
+			if (s == size_t(n)) break;
+			if (ep.ep_moves.size() == board::size_x * board::size_y) throw std::runtime_error("corrupted archive: too many moves");
+			episode::move mv;
+			if (s < size_t(n)) {
+				for (size_t k = 0; k < s; k++) legal &= legal - 1;
+				mv.code = (who << 14) | bitboard::lowest(legal);
+			} else {
+				mv.code = dec.decode_bits(16);
+			}
+			int i = int16_t(mv.code << 2) >> 2;
+			board::point p(i);
+			state.place(p.x, p.y, mv.code >> 14);
+			mv.cost = decode_number(dec, times);
+			ep.ep_moves.push_back(mv);
+		}
+	}
+
+private:
+	static uint64_t zigzag(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+	static int64_t unzigzag(uint64_t v) { return int64_t(v >> 1) ^ -int64_t(v & 1); }
+
+	static void encode_number(range_encoder& enc, adaptive_model& model, uint64_t v) {
+		for (; v >= 0x80; v >>= 7) model.encode(enc, (v & 0x7f) | 0x80);
+		model.encode(enc, v);
+	}
+	static uint64_t decode_number(range_decoder& dec, adaptive_model& model) {
+		uint64_t v = 0;
+		for (unsigned shift = 0; shift < 64; shift += 7) {
+			uint64_t byte = model.decode(dec);
+			v |= (byte & 0x7f) << shift;
+			if (byte < 0x80) break;
+		}
+		return v;
+	}
+
+	void encode_tag(range_encoder& enc, const std::string& tag, const std::string& prev, adaptive_model& same) {
+		same.encode(enc, tag == prev);
+		if (tag == prev) return;
+		encode_number(enc, numbers, tag.size());
+		for (char c : tag) chars.encode(enc, uint8_t(c));
+	}
+	std::string decode_tag(range_decoder& dec, const std::string& prev, adaptive_model& same) {
+		if (same.decode(dec)) return prev;
+		uint64_t size = decode_number(dec, numbers);
+		if (size > max_tag) throw std::runtime_error("corrupted archive: tag too long");
+		std::string tag(size, '\0');
+		for (char& c : tag) c = char(chars.decode(dec));
+		return tag;
+	}
+
+private:
+	static constexpr size_t max_tag = 4096; // the longest tag decoded, since a corrupted length would be allocated as is
+	std::vector<adaptive_model> moves;
+	adaptive_model times;
+	adaptive_model numbers;
+	adaptive_model chars;
+	adaptive_model same_open;
+	adaptive_model same_close;
+	episode::meta last;
+	episode::meta last_close;
+};
+
+/**
+ * the archive file holds a header, the blocks, and the index of the blocks
+ * each block codes up to block_games episodes from fresh models, so it can be decoded alone
+ */
+struct archive_format {
+	struct header {
+		char magic[8];
+		uint64_t games;
+		uint64_t blocks;
+		uint64_t index; // the offset of the index
+	};
+	struct block {
+		uint64_t offset;
+		uint64_t length;
+		uint64_t first; // the index of the first game
+		uint64_t games;
+	};
+};
+
+/**
+ * write episodes to an archive as a stream, where a block is written once it is full
+ */
+class archive_writer {
+public:
+	archive_writer(const std::string& path, size_t block_games = 4096)
+			: path(path), out(path, std::ios::out | std::ios::binary | std::ios::trunc),
+			  block_games(block_games), games(0), enc(nullptr) {
+		archive_format::header head = {};
+		out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+		if (!out) throw std::runtime_error("cannot write archive: " + path);
+	}
+	archive_writer(const archive_writer&) = delete;
+	archive_writer& operator =(const archive_writer&) = delete;
+	~archive_writer() {
+		delete enc;
+	}
+
+	void write(const episode& ep) {
+		if (enc == nullptr) {
+			codec.reset();
+			buffer.clear();
+			enc = new range_encoder(buffer);
+		}
+		codec.encode(*enc, ep);
+		games++;
+		if (games - first() == block_games) flush();
+	}
+
+	/**
+	 * write the last block and the index
+	 */
+	void close() {
+		flush();
+		archive_format::header head;
+		std::memcpy(head.magic, "NOGOARCH", 8);
+		head.games = games;
+		head.blocks = index.size();
+		head.index = out.tellp();
+		out.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(archive_format::block));
+		out.seekp(0);
+		out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+		out.close();
+		if (!out) throw std::runtime_error("cannot write archive: " + path);
+	}
+
+	size_t size() const { return games; }
+
+private:
+	size_t first() const { return index.size() ? index.back().first + index.back().games : 0; }
+
+	void flush() {
+		if (enc == nullptr) return;
+		enc->flush();
+		delete enc;
+		enc = nullptr;
+		index.push_back({ uint64_t(out.tellp()), buffer.size(), first(), games - first() });
+		out.write(buffer.data(), buffer.size());
+	}
+
+private:
+	std::string path;
+	std::ofstream out;
+	size_t block_games;
+	size_t games;
+	std::vector<archive_format::block> index;
+	archive_codec codec;
+	std::string buffer;
+	range_encoder* enc;
+};
+
+/**
+ * read episodes from an archive, which is memory-mapped so that any block can be decoded directly
+ */
+class archive_reader {
+public:
+	archive_reader(const std::string& path) : head(nullptr), length(0) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd == -1) throw std::runtime_error("cannot open archive: " + path);
+		struct stat st;
+		if (::fstat(fd, &st) == -1 || size_t(st.st_size) < sizeof(archive_format::header)) {
+			::close(fd);
+			throw std::runtime_error("invalid archive: " + path);
+		}
+		length = st.st_size;
+		void* addr = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (addr == MAP_FAILED) throw std::runtime_error("cannot map archive: " + path);
+		head = static_cast<const archive_format::header*>(addr);
+		if (!valid()) {
+			::munmap(addr, length);
+			throw std::runtime_error("invalid archive: " + path);
+		}
+	}
+	archive_reader(const archive_reader&) = delete;
+	archive_reader& operator =(const archive_reader&) = delete;
+	~archive_reader() {
+		::munmap(const_cast<archive_format::header*>(head), length);
+	}
+
+	size_t games() const { return head->games; }
+	size_t blocks() const { return head->blocks; }
+	const archive_format::block& block(size_t i) const { return index[i]; }
+
+	/**
+	 * decode the episodes of the i-th block
+	 */
+	std::vector<episode> read(size_t i) const {
+		return read(i, index[i].games);
+	}
+
+	/**
+	 * decode the episode of the given game, which only decodes its block up to the game
+	 */
+	episode at(size_t game) const {
+		if (game >= head->games) throw std::out_of_range("no such game in archive");
+		const archive_format::block* blk = std::upper_bound(index, index + head->blocks, game,
+			[](size_t game, const archive_format::block& b) { return game < b.first; }) - 1;
+		return read(blk - index, game - blk->first + 1).back();
+	}
+
+private:
+	/**
+	 * check the header and the index, where every block must lie between the header and the index,
+	 * and the blocks must count the games in order
+	 */
+	bool valid() {
+		if (std::memcmp(head->magic, "NOGOARCH", 8) != 0 || head->index < sizeof(archive_format::header)
+		        || head->index > length || (length - head->index) / sizeof(archive_format::block) != head->blocks
+		        || (length - head->index) % sizeof(archive_format::block) != 0) return false;
+		index = reinterpret_cast<const archive_format::block*>(reinterpret_cast<const char*>(head) + head->index);
+		uint64_t games = 0;
+		for (size_t i = 0; i < head->blocks; i++) {
+			const archive_format::block& b = index[i];
+			if (b.offset < sizeof(archive_format::header) || b.offset > head->index || b.length > head->index - b.offset
+			        || b.first != games || b.games > head->games - games) return false;
+			games += b.games;
+		}
+		return games == head->games;
+	}
+
+	/**
+	 * decode the first n episodes of the i-th block, or throw std::runtime_error if the block is corrupted
+	 */
+	std::vector<episode> read(size_t i, size_t n) const {
+		const char* data = reinterpret_cast<const char*>(head) + index[i].offset;
+		range_decoder dec(data, data + index[i].length);
+		archive_codec codec;
+		std::vector<episode> res;
+		for (size_t k = 0; k < n; k++) {
+			res.emplace_back();
+			codec.decode(dec, res.back());
+			if (dec.overrun()) throw std::runtime_error("corrupted archive: block " + std::to_string(i));
+		}
+		return res;
+	}
+
+private:
+	const archive_format::header* head;
+	size_t length;
+	const archive_format::block* index;
+};
@@ -0,0 +1,130 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * arena.h: Contiguous storage for search trees
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <new>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * a bump allocator of trivially copyable objects over a reserved range of virtual memory
+ *
+ * objects are referred by indices relative to the arena, so the content can be written to a file
+ * and mapped back at any address; the memory is reserved once and never moves, so pointers stay valid
+ * until clear()
+ *
+ * the memory may be backed by huge pages to reduce TLB misses: explicit huge pages (MAP_HUGETLB) are tried first,
+ * then transparent huge pages (MADV_HUGEPAGE), and finally normal pages
+ */
+template<typename type>
+class arena {
+	static_assert(std::is_trivially_copyable<type>::value, "arena objects must be trivially copyable");
+public:
+	arena(size_t capacity, bool huge = false) : base(nullptr), used(0), limit(capacity), length(0), huge(false) {
+		void* addr = MAP_FAILED;
+		if (huge) {
+			length = (limit * sizeof(type) + huge_page_size - 1) / huge_page_size * huge_page_size;
+			// reserved up front, since touching an unavailable huge page would raise SIGBUS
+			addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+			              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			this->huge = addr != MAP_FAILED;
+		}
+		if (addr == MAP_FAILED) {
+			length = bytes(limit);
+			addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+			              MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+			if (addr == MAP_FAILED) throw std::bad_alloc();
+			if (huge) ::madvise(addr, length, MADV_HUGEPAGE); // ignored if THP is disabled
+		}
+		base = static_cast<type*>(addr);
+	}
+	arena(const arena&) = delete;
+	arena& operator =(const arena&) = delete;
+	~arena() { ::munmap(base, length); }
+
+	type& operator [](size_t i) { return base[i]; }
+	const type& operator [](size_t i) const { return base[i]; }
+	size_t index(const type* p) const { return p - base; }
+	size_t size() const { return used; }
+	size_t capacity() const { return limit; }
+	type* data() { return base; }
+	const type* data() const { return base; }
+	size_t reserved() const { return length; }
+	bool huge_pages() const { return huge; }
+
+	/**
+	 * allocate n consecutive objects, or return nullptr if the arena is full
+	 */
+	type* allocate(size_t n = 1) {
+		if (used + n > limit) return nullptr;
+		type* p = base + used;
+		for (size_t i = 0; i < n; i++) new (p + i) type();
+		used += n;
+		return p;
+	}
+
+	/**
+	 * fault in the pages of the first n objects ahead of use, which must not hold any object yet
+	 */
+	void prefault(size_t n) {
+		size_t end = std::min(n, limit) * sizeof(type), step = huge ? huge_page_size : page_size();
+		volatile char* p = reinterpret_cast<volatile char*>(base);
+		for (size_t off = used * sizeof(type); off < end; off += step) p[off] = 0;
+	}
+
+	/**
+	 * release all the objects, while the touched pages are kept for later use
+	 */
+	void clear() { used = 0; }
+
+	/**
+	 * exchange the memory and the objects with another arena
+	 */
+	void swap(arena& other) {
+		std::swap(base, other.base);
+		std::swap(used, other.used);
+		std::swap(limit, other.limit);
+		std::swap(length, other.length);
+		std::swap(huge, other.huge);
+	}
+
+	/**
+	 * map n objects at the given offset of a file (which must be page-aligned) to the front of the arena
+	 * the mapping is private, i.e., later changes are not written back to the file
+	 * note that a file cannot be mapped over explicit huge pages, in which case false is returned;
+	 * false is also returned if the file is too short, since touching the pages beyond its end would raise SIGBUS
+	 */
+	bool map(int fd, size_t offset, size_t n) {
+		if (n > limit || huge) return false;
+		struct stat info;
+		if (::fstat(fd, &info) != 0 || size_t(info.st_size) < offset + n * sizeof(type)) return false;
+		if (n && ::mmap(base, n * sizeof(type), PROT_READ | PROT_WRITE,
+		                MAP_PRIVATE | MAP_FIXED, fd, offset) == MAP_FAILED) return false;
+		used = n;
+		return true;
+	}
+
+	static size_t page_size() { return ::sysconf(_SC_PAGESIZE); }
+
+private:
+	static constexpr size_t huge_page_size = 2 << 20;
+	static size_t bytes(size_t n) { return (n * sizeof(type) + page_size() - 1) / page_size() * page_size(); }
+
+private:
+	type* base;
+	size_t used;
+	size_t limit;
+	size_t length;
+	bool huge;
+};
@@ -0,0 +1,151 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * bitboard.h: Bit-parallel representation of the game state for fast move generation
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <cstdint>
+#include "board.h"
+
+/**
+ * the 9x9 board packed into 128-bit masks, one mask per color
+ * bit i corresponds to the 1-d array style index of board::point, i.e., i == x * size_y + y
+ *
+ * place() follows exactly the rules (and the nogo_move_result codes) of board::place,
+ * while legal() generates all the legal placements of a side at once
+ */
+class bitboard {
+public:
+	typedef unsigned __int128 mask;
+	typedef board::reward reward;
+
+public:
+	bitboard() : stone{0, 0}, turn(board::black) {}
+	bitboard(const board& b) : stone{0, 0}, turn(b.info().who_take_turns) {
+		for (int i = 0; i < board::size_x * board::size_y; i++) {
+			board::cell c = b(i);
+			if (c == board::black || c == board::white) stone[c - 1] |= bit(i);
+		}
+	}
+	bitboard(const bitboard& b) = default;
+	bitboard& operator =(const bitboard& b) = default;
+
+	operator board() const {
+		board b;
+		for (int i = 0; i < board::size_x * board::size_y; i++) {
+			if (stone[0] & bit(i)) b(i) = board::black;
+			if (stone[1] & bit(i)) b(i) = board::white;
+		}
+		b.info({turn});
+		return b;
+	}
+
+	mask stones(unsigned who) const { return stone[who - 1]; }
+	mask empty() const { return playable() & ~stone[0] & ~stone[1]; }
+	board::piece_type take_turns() const { return turn; }
+	void take_turns(board::piece_type who) { turn = who; }
+
+public:
+	/**
+	 * place a stone to the specific position, same as board::place
+	 * return nogo_move_result::legal if the action is valid, or nogo_move_result::illegal_* if not
+	 */
+	reward place(int x, int y, unsigned who = board::unknown) {
+		if (who == -1u) who = turn;
+		if (who != turn) return board::illegal_turn;
+		if (x == -1 && y == -1) return board::illegal_pass;
+		if (x < 0 || x >= board::size_x || y < 0 || y >= board::size_y) return board::illegal_out_of_range;
+		mask p = bit(x * board::size_y + y);
+		if (p & hollow()) return board::illegal_out_of_range;
+		mask& own = stone[who - 1];
+		mask& opp = stone[2 - who];
+		if (own & p) return board::illegal_same_color;
+		if (opp & p) return board::illegal_not_empty;
+		mask space = playable() & ~(own | p) & ~opp;
+		if (!(neighbor(block(p, own | p)) & space)) return board::illegal_suicide;
+		for (mask near = neighbor(p) & opp; near; near &= near - 1) {
+			if (!(neighbor(block(near & -near, opp)) & space)) return board::illegal_take;
+		}
+		own |= p; // is legal move!
+		turn = static_cast<board::piece_type>(3u - who);
+		return board::legal;
+	}
+	reward place(const board::point& p, unsigned who = board::unknown) {
+		return place(p.x, p.y, who);
+	}
+
+	/**
+	 * generate all the legal placements of who, regardless of whose turn it is
+	 * an empty point is legal iff the new block keeps a liberty and no adjacent opponent block loses its last liberty
+	 */
+	mask legal(unsigned who) const {
+		mask own = stone[who - 1], opp = stone[2 - who], space = empty();
+		mask safe = neighbor(space), atari = 0;
+		for (mask rest = own; rest; ) {
+			mask blk = block(rest & -rest, own);
+			mask lib = neighbor(blk) & space;
+			if (count(lib) >= 2) safe |= lib;
+			rest &= ~blk;
+		}
+		for (mask rest = opp; rest; ) {
+			mask blk = block(rest & -rest, opp);
+			mask lib = neighbor(blk) & space;
+			if (count(lib) == 1) atari |= lib;
+			rest &= ~blk;
+		}
+		return space & safe & ~atari;
+	}
+
+	/**
+	 * calculate the liberty of the block of piece at [x][y]
+	 * return >= 0 if [x][y] is placed by who; otherwise return -1
+	 *
+	 * note that each empty point is counted once, while board::check_liberty may count a point several times
+	 */
+	int check_liberty(int x, int y, unsigned who) const {
+		mask p = bit(x * board::size_y + y);
+		if (!(stone[who - 1] & p)) return -1;
+		return count(neighbor(block(p, stone[who - 1])) & empty());
+	}
+
+public:
+	static constexpr mask bit(int i) { return mask(1) << i; }
+	static int count(mask m) { return __builtin_popcountll(uint64_t(m)) + __builtin_popcountll(uint64_t(m >> 64)); }
+	static int lowest(mask m) { return uint64_t(m) ? __builtin_ctzll(uint64_t(m)) : 64 + __builtin_ctzll(uint64_t(m >> 64)); }
+
+	/**
+	 * the 4-neighborhood of the given points, which may include the points themselves
+	 */
+	static mask neighbor(mask m) {
+		return ((m << board::size_y) | (m >> board::size_y) | ((m & ~edge(board::size_y - 1)) << 1) | ((m & ~edge(0)) >> 1)) & full();
+	}
+
+	/**
+	 * the block connected to seed within the given stones
+	 */
+	static mask block(mask seed, mask stones) {
+		for (mask grow = seed; ; seed = grow) {
+			grow = (seed | neighbor(seed)) & stones;
+			if (grow == seed) return seed;
+		}
+	}
+
+	static constexpr mask full() { return bit(board::size_x * board::size_y) - 1; }
+	static constexpr mask playable() { return full() & ~hollow(); }
+	static constexpr mask edge(int y, int x = 0) {
+		return x < board::size_x ? bit(x * board::size_y + y) | edge(y, x + 1) : 0;
+	}
+	static constexpr mask hollow(int k = 0) {
+		return k < board::hollow_x * board::hollow_y ?
+			bit(((board::size_x - board::hollow_x) / 2 + k / board::hollow_y) * board::size_y
+			    + (board::size_y - board::hollow_y) / 2 + k % board::hollow_y) | hollow(k + 1) : 0;
+	}
+
+private:
+	mask stone[2];
+	board::piece_type turn;
+};
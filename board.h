@@ -15,6 +15,7 @@
 #include <algorithm>
 #include <utility>
 #include <cmath>
+#include <cstdint>
 
 /**
  * definition for the 9x9 board
@@ -230,6 +231,29 @@ public:
 	void rotate_left() { transpose(); reflect_horizontal(); } // counterclockwise
 	void reverse() { reflect_horizontal(); reflect_vertical(); }
 
+	/**
+	 * Zobrist hash of the pieces and the side to move
+	 */
+	uint64_t hash() const {
+		uint64_t h = zobrist()[size_x * size_y][attr.who_take_turns & 0b11];
+		for (int i = 0; i < size_x * size_y; i++) h ^= zobrist()[i][operator()(i) & 0b11];
+		return h;
+	}
+
+	/**
+	 * the minimal hash among the 8 symmetries of the board, i.e., same for symmetric positions
+	 */
+	uint64_t canonical_hash() const {
+		board b = *this;
+		uint64_t h = b.hash();
+		for (int i = 1; i < 8; i++) {
+			if (i == 4) b.transpose();
+			else b.rotate_right();
+			h = std::min(h, b.hash());
+		}
+		return h;
+	}
+
 public:
 	friend std::ostream& operator <<(std::ostream& out, const board& b) {
 		std::ios ff(nullptr);
@@ -299,6 +323,21 @@ protected:
 			for (int y = hollow.y; y < hollow.y + hollow_y; y++)
 				stone[x][y] = piece_type::hollow;
 	}
+	typedef std::array<std::array<uint64_t, 4>, size_x * size_y + 1> zobrist_table;
+	static const zobrist_table& zobrist() { static zobrist_table keys; return keys; }
+	static __attribute__((constructor)) void init_zobrist_keys() {
+		zobrist_table& keys = const_cast<zobrist_table&>(zobrist());
+		uint64_t seed = 0;
+		for (auto& cell : keys) {
+			for (uint64_t& key : cell) { // splitmix64
+				uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+				z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+				z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+				key = z ^ (z >> 31);
+			}
+		}
+		for (auto& cell : keys) cell[empty] = cell[hollow] = 0;
+	}
 private:
 	grid stone;
 	data attr;
@@ -0,0 +1,131 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * book.h: Persistent learning book of position results
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <atomic>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include "board.h"
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "the shared book requires lock-free atomics");
+
+/**
+ * a hash table of position results stored in a memory-mapped file
+ * positions are keyed by board::canonical_hash, so symmetric positions share an entry
+ *
+ * the table uses open addressing with linear probing, and never deletes entries;
+ * the file is mapped as shared, so several players (or processes) may update the same book, where entries are
+ * claimed by compare-and-swap on the key and updated by atomic additions as in transposition_table;
+ * the file is locked while it is created or checked, so a book being created is not seen half-initialized
+ */
+class learning_book {
+public:
+	struct entry {
+		std::atomic<uint64_t> key;
+		std::atomic<uint32_t> win; // the number of games won by black
+		std::atomic<uint32_t> total;
+	};
+
+	/**
+	 * open the book, or create it with the given capacity (rounded up to a power of 2) if it does not exist
+	 */
+	learning_book(const std::string& path, size_t capacity = 1 << 20) : fd(-1), head(nullptr) {
+		fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (fd == -1) throw std::runtime_error("cannot open book: " + path);
+		if (::flock(fd, LOCK_EX) == -1) fail("cannot lock book: " + path);
+		struct stat st;
+		if (::fstat(fd, &st) == -1) fail("cannot stat book: " + path);
+		if (st.st_size == 0) { // create a new book
+			size_t n = 1;
+			while (n < capacity) n <<= 1;
+			if (::ftruncate(fd, sizeof(header) + n * sizeof(entry)) == -1)
+				fail("cannot allocate book: " + path);
+			st.st_size = sizeof(header) + n * sizeof(entry);
+			map(path, st.st_size);
+			std::memcpy(head->magic, "NOGOBOOK", 8);
+			head->capacity = n;
+		} else {
+			map(path, st.st_size);
+			if (std::memcmp(head->magic, "NOGOBOOK", 8) != 0
+			        || st.st_size != off_t(sizeof(header) + head->capacity * sizeof(entry)))
+				fail("invalid book: " + path);
+		}
+		table = reinterpret_cast<entry*>(head + 1);
+		::flock(fd, LOCK_UN);
+	}
+	learning_book(const learning_book&) = delete;
+	learning_book& operator =(const learning_book&) = delete;
+	~learning_book() {
+		release();
+	}
+
+	/**
+	 * find the entry of a position, or return nullptr if the position is not in the book
+	 */
+	const entry* find(uint64_t key) const {
+		key |= 1; // 0 is reserved for empty slots
+		for (size_t i = key & (head->capacity - 1), n = 0; n < head->capacity; i = (i + 1) & (head->capacity - 1), n++) {
+			uint64_t k = table[i].key.load(std::memory_order_acquire);
+			if (k == key) return &table[i];
+			if (k == 0) return nullptr;
+		}
+		return nullptr;
+	}
+
+	/**
+	 * add a game result of a position, which is silently dropped if the book is full
+	 */
+	void update(uint64_t key, bool black_win) {
+		key |= 1;
+		for (size_t i = key & (head->capacity - 1), n = 0; n < head->capacity; i = (i + 1) & (head->capacity - 1), n++) {
+			uint64_t k = table[i].key.load(std::memory_order_acquire);
+			if (k == 0 && table[i].key.compare_exchange_strong(k, key, std::memory_order_acq_rel)) k = key;
+			if (k != key) continue;
+			table[i].win.fetch_add(black_win ? 1 : 0, std::memory_order_relaxed);
+			table[i].total.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+
+private:
+	struct header {
+		char magic[8];
+		uint64_t capacity;
+	};
+
+	void map(const std::string& path, size_t size) {
+		void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (addr == MAP_FAILED) fail("cannot map book: " + path);
+		head = static_cast<header*>(addr);
+	}
+
+	void release() {
+		if (head) ::munmap(head, sizeof(header) + head->capacity * sizeof(entry));
+		if (fd != -1) ::close(fd);
+		head = nullptr;
+		fd = -1;
+	}
+
+	void fail(const std::string& msg) {
+		release();
+		throw std::runtime_error(msg);
+	}
+
+private:
+	int fd;
+	header* head;
+	entry* table;
+};
@@ -0,0 +1,168 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * database.h: Position index over saved game records
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "board.h"
+#include "action.h"
+#include "episode.h"
+
+/**
+ * an index from positions to the games passing through them, stored in a read-only memory-mapped file
+ * positions are keyed by board::canonical_hash, so symmetric positions share an entry
+ *
+ * the file holds a header, the positions sorted by key (with the aggregated results),
+ * and the occurrences (game, ply) grouped by position, so a query is a binary search
+ */
+class position_index {
+public:
+	struct position {
+		uint64_t key;
+		uint64_t first; // the index of the first occurrence
+		uint32_t count; // the number of occurrences
+		uint32_t win; // the number of occurrences in games won by black
+	};
+	struct occurrence {
+		uint32_t game; // the index of the game in the record file
+		uint32_t ply; // the number of moves played before the position
+	};
+
+	/**
+	 * replay the games and write their positions (including the initial one) to an index file
+	 * return the number of positions
+	 */
+	template<typename iterator>
+	static size_t build(iterator first, iterator last, const std::string& path) {
+		struct record {
+			uint64_t key;
+			occurrence at;
+			bool win;
+			bool operator <(const record& r) const {
+				return key != r.key ? key < r.key : at.game != r.at.game ? at.game < r.at.game : at.ply < r.at.ply;
+			}
+		};
+		std::vector<record> records;
+		uint32_t game = 0;
+		for (iterator it = first; it != last; it++, game++) {
+			const episode& ep = *it;
+			bool win = ep.step() % 2 == 1; // black made the last move
+			board state;
+			uint32_t ply = 0;
+			records.push_back({ state.canonical_hash(), { game, ply }, win });
+			for (const episode::move& mv : ep.moves()) {
+				if (action(mv).apply(state) != board::legal) break;
+				records.push_back({ state.canonical_hash(), { game, ++ply }, win });
+			}
+		}
+		std::sort(records.begin(), records.end());
+
+		std::vector<position> positions;
+		std::vector<occurrence> occurrences;
+		occurrences.reserve(records.size());
+		for (const record& r : records) {
+			if (positions.empty() || positions.back().key != r.key)
+				positions.push_back({ r.key, occurrences.size(), 0, 0 });
+			positions.back().count++;
+			positions.back().win += r.win ? 1 : 0;
+			occurrences.push_back(r.at);
+		}
+
+		header head;
+		std::memcpy(head.magic, "NOGOINDX", 8);
+		head.positions = positions.size();
+		head.occurrences = occurrences.size();
+		head.games = game;
+		std::string temp = path + ".tmp";
+		std::ofstream out(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+		out.write(reinterpret_cast<const char*>(positions.data()), positions.size() * sizeof(position));
+		out.write(reinterpret_cast<const char*>(occurrences.data()), occurrences.size() * sizeof(occurrence));
+		out.close();
+		if (!out || std::rename(temp.c_str(), path.c_str()) != 0) {
+			std::remove(temp.c_str());
+			throw std::runtime_error("cannot write index: " + path);
+		}
+		return positions.size();
+	}
+
+public:
+	/**
+	 * open an index file built by build()
+	 */
+	position_index(const std::string& path) : head(nullptr), length(0) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd == -1) throw std::runtime_error("cannot open index: " + path);
+		struct stat st;
+		if (::fstat(fd, &st) == -1 || size_t(st.st_size) < sizeof(header)) {
+			::close(fd);
+			throw std::runtime_error("invalid index: " + path);
+		}
+		length = st.st_size;
+		void* addr = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (addr == MAP_FAILED) throw std::runtime_error("cannot map index: " + path);
+		head = static_cast<const header*>(addr);
+		if (std::memcmp(head->magic, "NOGOINDX", 8) != 0 || length != sizeof(header)
+		        + head->positions * sizeof(position) + head->occurrences * sizeof(occurrence)) {
+			::munmap(addr, length);
+			throw std::runtime_error("invalid index: " + path);
+		}
+		table = reinterpret_cast<const position*>(head + 1);
+		list = reinterpret_cast<const occurrence*>(table + head->positions);
+	}
+	position_index(const position_index&) = delete;
+	position_index& operator =(const position_index&) = delete;
+	~position_index() {
+		::munmap(const_cast<header*>(head), length);
+	}
+
+	size_t positions() const { return head->positions; }
+	size_t occurrences() const { return head->occurrences; }
+	size_t games() const { return head->games; }
+
+	/**
+	 * find a position (or any of its symmetries), or return nullptr if no game passes through it
+	 */
+	const position* find(const board& state) const {
+		uint64_t key = state.canonical_hash();
+		const position* it = std::lower_bound(table, table + head->positions, key,
+			[](const position& p, uint64_t key) { return p.key < key; });
+		return it != table + head->positions && it->key == key ? it : nullptr;
+	}
+
+	/**
+	 * the occurrences of a position, ordered by game and ply
+	 */
+	const occurrence* begin(const position& p) const { return list + p.first; }
+	const occurrence* end(const position& p) const { return list + p.first + p.count; }
+
+private:
+	struct header {
+		char magic[8];
+		uint64_t positions;
+		uint64_t occurrences;
+		uint64_t games;
+	};
+
+private:
+	const header* head;
+	size_t length;
+	const position* table;
+	const occurrence* list;
+};
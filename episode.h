@@ -15,14 +15,19 @@
 #include <sstream>
 #include <chrono>
 #include <numeric>
+#include <iterator>
+#include <cstdint>
+#include <cctype>
 #include "board.h"
 #include "action.h"
 #include "agent.h"
 
 class statistic;
+class archive_codec;
 
 class episode {
 friend class statistic;
+friend class archive_codec;
 public:
 	episode() : ep_state(initial_state()), ep_score(0), ep_time(0) {
 		ep_moves.reserve(board::size_x * board::size_y);
@@ -42,7 +47,7 @@ public:
 	bool apply_action(action move) {
 		board::reward reward = move.apply(state());
 		if (reward != board::legal) return false;
-		ep_moves.emplace_back(move, reward, millisec() - ep_time);
+		ep_moves.emplace_back(move, millisec() - ep_time);
 		ep_score += reward;
 		return true;
 	}
@@ -72,11 +77,9 @@ public:
 		switch (who) {
 		case board::black:
 		case action::black::type:
-			for (size_t i = 0; i < ep_moves.size(); i += 2) time += ep_moves[i].time;
-			break;
 		case board::white:
 		case action::white::type:
-			for (size_t i = 1; i < ep_moves.size(); i += 2) time += ep_moves[i].time;
+			for (const move& mv : moves(who)) time += mv.time();
 			break;
 		case action::place::type:
 		default:
@@ -86,23 +89,26 @@ public:
 		return time;
 	}
 
-	std::vector<action> actions(unsigned who = -1u) const {
-		std::vector<action> res;
+	class move;
+	class move_range;
+
+	/**
+	 * the moves of a side (or all the moves) in place, without copying
+	 */
+	move_range moves(unsigned who = -1u) const {
 		switch (who) {
 		case board::black:
-		case action::black::type:
-			for (size_t i = 0; i < ep_moves.size(); i += 2) res.push_back(ep_moves[i]);
-			break;
+		case action::black::type: return move_range(ep_moves, 0, 2);
 		case board::white:
-		case action::white::type:
-			for (size_t i = 1; i < ep_moves.size(); i += 2) res.push_back(ep_moves[i]);
-			break;
+		case action::white::type: return move_range(ep_moves, 1, 2);
 		case action::place::type:
-		default:
-			res.assign(ep_moves.begin(), ep_moves.end());
-			break;
+		default:                  return move_range(ep_moves, 0, 1);
 		}
-		return res;
+	}
+
+	std::vector<action> actions(unsigned who = -1u) const {
+		move_range range = moves(who);
+		return std::vector<action>(range.begin(), range.end());
 	}
 
 public:
@@ -149,33 +155,144 @@ public:
 		return in;
 	}
 
-protected:
+	/**
+	 * parse a record from the characters in [first, last), the same as operator >> but without streams,
+	 * so that large record files can be parsed in place (and in parallel)
+	 * return false if there is no record, or (if strict) if the record is not complete, i.e., it is not closed by ')',
+	 * or there is anything other than the moves between the header and ')', or anything but spaces after ')'
+	 */
+	bool parse(const char* first, const char* last, bool strict = false) {
+		*this = {};
+		const char* end = std::find(first, last, ')');
+		const char* begin = std::find(first, end, '(');
+		const char* head = "C[TCG|";
+		const char* at = std::search(begin != end ? begin : first, end, head, head + 6);
+		if (at == end) return false;
+		at = parse_meta(at + 6, end, ep_open);
+		if (at != end) at++; // |
+		at = parse_meta(at, end, ep_close);
+		if (strict && (at == end || *at != ']')) return false;
+		at = std::find(at, end, ';');
+		while (end - at >= 6 && at[0] == ';' && at[2] == '[' && at[5] == ']') { // ;B[aa]
+			unsigned who = board::empty;
+			if (at[1] == 'B') who = board::black;
+			if (at[1] == 'W') who = board::white;
+			action::place code(at[3] - 'a', (board::size_y - 1) - (at[4] - 'a'), who);
+			time_t time = 0;
+			at += 6;
+			if (end - at >= 2 && at[0] == 'C' && at[1] == '[') { // C[ms]
+				at = parse_number(at + 2, end, time);
+				if (strict && (at == end || *at != ']')) return false;
+				if (at != end) at++; // ]
+			}
+			ep_moves.emplace_back(code, time);
+		}
+		if (strict && (at != end || end == last || std::find_if(end + 1, last, [](char c) { return !std::isspace(uint8_t(c)); }) != last))
+			return false;
+		ep_score = 0;
+		return true;
+	}
 
-	struct move {
-		action code;
-		board::reward reward;
-		time_t time;
-		move(action code = {}, board::reward reward = 0, time_t time = 0) : code(code), reward(reward), time(time) {}
+public:
+
+	/**
+	 * a move packed into 4 bytes
+	 *  the position (14 bits, signed) and the color (2 bits) of the placement, where 0xffff is an unknown action
+	 *  the thinking time in milliseconds, exact below 32768 ms, or in units of 1024 ms otherwise
+	 */
+	class move {
+	friend class archive_codec;
+	public:
+		move(action code = {}, time_t time = 0) : code(pack(code)), cost(compress(time)) {}
+
+		operator action() const { return unpack(code); }
+		time_t time() const { return cost & 0x8000 ? time_t(cost & 0x7fff) << 10 : cost; }
 
-		operator action() const { return code; }
 		friend std::ostream& operator <<(std::ostream& out, const move& m) {
-			out << m.code;
-			if (m.time) out << "C[" << std::dec << m.time << "]";
+			out << action(m);
+			if (m.cost) out << "C[" << std::dec << m.time() << "]";
 			return out;
 		}
 		friend std::istream& operator >>(std::istream& in, move& m) {
-			in >> m.code;
-			m.reward = 0;
-			m.time = 0;
+			action code;
+			time_t time = 0;
+			in >> code;
 			if (in.peek() == 'C') {
 				in.ignore(2); // C[
-				in >> std::dec >> m.time;
+				in >> std::dec >> time;
 				in.ignore(1); // ]
 			}
+			m = move(code, time);
 			return in;
 		}
+
+	private:
+		static uint16_t pack(action a) {
+			if (a.type() != action::place::type && a.type() != action::black::type && a.type() != action::white::type) return 0xffff;
+			action::place mv(a);
+			return ((mv.color() & 0b11) << 14) | (mv.position().i & 0x3fff);
+		}
+		static action unpack(uint16_t code) {
+			if (code == 0xffff) return {};
+			return action::place(int16_t(code << 2) >> 2, code >> 14);
+		}
+		static uint16_t compress(time_t time) {
+			if (time < 0) return 0;
+			if (time < 0x8000) return time;
+			return 0x8000 | std::min<time_t>(time >> 10, 0x7fff);
+		}
+
+	private:
+		uint16_t code;
+		uint16_t cost;
 	};
 
+	/**
+	 * a strided view of the moves, e.g., every other move for the moves of a side
+	 */
+	class move_range {
+	public:
+		class iterator : public std::iterator<std::random_access_iterator_tag, const move> {
+		public:
+			iterator(const move* at = nullptr, size_t stride = 1) : at(at), stride(stride) {}
+			const move& operator *() const { return *at; }
+			const move* operator ->() const { return at; }
+			const move& operator [](ptrdiff_t n) const { return at[n * ptrdiff_t(stride)]; }
+			iterator& operator ++() { at += stride; return *this; }
+			iterator operator ++(int) { iterator it = *this; at += stride; return it; }
+			iterator& operator --() { at -= stride; return *this; }
+			iterator operator --(int) { iterator it = *this; at -= stride; return it; }
+			iterator& operator +=(ptrdiff_t n) { at += n * ptrdiff_t(stride); return *this; }
+			iterator& operator -=(ptrdiff_t n) { at -= n * ptrdiff_t(stride); return *this; }
+			iterator operator +(ptrdiff_t n) const { return iterator(at + n * ptrdiff_t(stride), stride); }
+			iterator operator -(ptrdiff_t n) const { return iterator(at - n * ptrdiff_t(stride), stride); }
+			ptrdiff_t operator -(const iterator& it) const { return (at - it.at) / ptrdiff_t(stride); }
+			bool operator ==(const iterator& it) const { return at == it.at; }
+			bool operator !=(const iterator& it) const { return at != it.at; }
+			bool operator <(const iterator& it) const { return at < it.at; }
+		private:
+			const move* at;
+			size_t stride;
+		};
+
+		move_range(const std::vector<move>& moves, size_t offset, size_t stride)
+			: first(moves.data() + std::min(offset, moves.size())), stride(stride),
+			  count(moves.size() > offset ? (moves.size() - offset + stride - 1) / stride : 0) {}
+
+		iterator begin() const { return iterator(first, stride); }
+		iterator end() const { return iterator(first + count * stride, stride); }
+		size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+		const move& operator [](size_t i) const { return first[i * stride]; }
+
+	private:
+		const move* first;
+		size_t stride;
+		size_t count;
+	};
+
+protected:
+
 	struct meta {
 		std::string tag;
 		time_t when;
@@ -189,6 +306,19 @@ protected:
 		}
 	};
 
+	static const char* parse_number(const char* at, const char* end, time_t& value) {
+		bool negative = at != end && *at == '-';
+		value = 0;
+		for (at += negative; at != end && *at >= '0' && *at <= '9'; at++) value = value * 10 + (*at - '0');
+		if (negative) value = -value;
+		return at;
+	}
+	static const char* parse_meta(const char* at, const char* end, meta& m) {
+		const char* sep = std::find(at, end, '@');
+		m.tag.assign(at, sep);
+		return parse_number(sep != end ? sep + 1 : end, end, m.when);
+	}
+
 	static board initial_state() {
 		return {};
 	}
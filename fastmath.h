@@ -0,0 +1,44 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * fastmath.h: Table-driven math functions for visit counts
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+/**
+ * log and sqrt of integer visit counts looked up from tables, which fall back to <cmath> beyond the tables
+ * the tables are built at startup, before the first search
+ */
+class fast_math {
+public:
+	enum { table_size = 1 << 18 };
+
+	static float log(uint32_t n) { return n < table_size ? tables().log[n] : std::log(float(n)); }
+	static float sqrt(uint32_t n) { return n < table_size ? tables().sqrt[n] : std::sqrt(float(n)); }
+	static float inv_sqrt(uint32_t n) { return n < table_size ? tables().inv_sqrt[n] : 1 / std::sqrt(float(n)); }
+	static float sqrt_log(uint32_t n) { return n < table_size ? tables().sqrt_log[n] : std::sqrt(std::log(float(n))); }
+
+private:
+	struct table {
+		float log[table_size];
+		float sqrt[table_size];
+		float inv_sqrt[table_size];
+		float sqrt_log[table_size];
+	};
+	static const table& tables() { static table t; return t; }
+	static __attribute__((constructor)) void init_tables() {
+		table& t = const_cast<table&>(tables());
+		for (uint32_t n = 0; n < table_size; n++) {
+			t.log[n] = std::log(float(n));
+			t.sqrt[n] = std::sqrt(float(n));
+			t.inv_sqrt[n] = 1 / std::sqrt(float(n));
+			t.sqrt_log[n] = std::sqrt(std::log(float(n)));
+		}
+	}
+};
@@ -0,0 +1,146 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * gtp.h: Pipelined reading of GTP commands
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+/**
+ * a GTP command with its optional numeric id, e.g., "12 genmove b"
+ */
+struct gtp_command {
+	std::string id;
+	std::vector<std::string> args;
+
+	/**
+	 * preprocess a line as GTP does (remove control characters and comments, and convert tabs to spaces),
+	 * then split the id and the arguments; return false if nothing is left
+	 */
+	bool parse(std::string line) {
+		line = line.substr(0, line.find('#'));
+		std::replace(line.begin(), line.end(), '\t', ' ');
+		line.erase(std::remove_if(line.begin(), line.end(), [](char c) { return std::iscntrl(uint8_t(c)); }), line.end());
+		id.clear();
+		args.clear();
+		std::istringstream iss(line);
+		for (std::string s; iss >> s; args.push_back(s));
+		if (args.size() && std::all_of(args[0].begin(), args[0].end(), ::isdigit)) {
+			id = args[0];
+			args.erase(args.begin());
+		}
+		return args.size();
+	}
+
+	/**
+	 * whether the command neither reads nor changes the game, so that it may overtake a running command
+	 */
+	bool stateless() const {
+		return args[0] == "name" || args[0] == "version" || args[0] == "protocol_version" || args[0] == "list_commands";
+	}
+};
+
+/**
+ * a GTP response, which is written as "=id text" for a success or "?id text" for a failure
+ */
+struct gtp_reply {
+	std::string text;
+	bool success = true;
+	bool terminate = false; // the shell should stop after this response
+
+	gtp_reply(const std::string& text = "", bool success = true, bool terminate = false)
+		: text(text), success(success), terminate(terminate) {}
+
+	void write(std::ostream& out, const std::string& id) const {
+		out << (success ? '=' : '?') << id << ' ' << text << "\n\n"; // flushed by the caller
+	}
+};
+
+/**
+ * read the GTP commands on a separate thread, so that the commands are queued while a long command is running
+ * the thread is detached, since it may be blocked on the input when the shell stops; it shares the queue with the reader
+ */
+class gtp_reader {
+public:
+	gtp_reader(std::istream& in) : shared(std::make_shared<state>()) {
+		std::shared_ptr<state> queue = shared;
+		std::thread([queue, &in]() { queue->run(in); }).detach();
+	}
+	gtp_reader(const gtp_reader&) = delete;
+	gtp_reader& operator =(const gtp_reader&) = delete;
+
+	/**
+	 * get the next command without removing it, or return false if there is no command now
+	 */
+	bool peek(gtp_command& cmd) {
+		std::lock_guard<std::mutex> guard(shared->lock);
+		if (shared->queue.empty()) return false;
+		cmd = shared->queue.front();
+		return true;
+	}
+	void pop() {
+		std::lock_guard<std::mutex> guard(shared->lock);
+		shared->queue.pop_front();
+	}
+	bool closed() {
+		std::lock_guard<std::mutex> guard(shared->lock);
+		return shared->queue.empty() && shared->eof;
+	}
+
+	/**
+	 * wait until wake() is called, or (if command is true) a command is available or the input is closed
+	 */
+	void wait(bool command = true) {
+		std::unique_lock<std::mutex> guard(shared->lock);
+		shared->ready.wait(guard, [&]() { return shared->woken || (command && (shared->queue.size() || shared->eof)); });
+		shared->woken = false;
+	}
+	void wake() {
+		{
+			std::lock_guard<std::mutex> guard(shared->lock);
+			shared->woken = true;
+		}
+		shared->ready.notify_all();
+	}
+
+private:
+	struct state {
+		std::mutex lock;
+		std::condition_variable ready;
+		std::deque<gtp_command> queue;
+		bool eof = false;
+		bool woken = false;
+
+		void run(std::istream& in) {
+			for (std::string line; std::getline(in, line); ) {
+				gtp_command cmd;
+				if (!cmd.parse(line)) continue;
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					queue.push_back(cmd);
+				}
+				ready.notify_all();
+			}
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				eof = true;
+			}
+			ready.notify_all();
+		}
+	};
+	std::shared_ptr<state> shared;
+};
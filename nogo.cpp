@@ -11,11 +11,20 @@
 #include <fstream>
 #include <iterator>
 #include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
 #include "board.h"
 #include "action.h"
 #include "agent.h"
 #include "episode.h"
 #include "statistic.h"
+#include "verify.h"
+#include "database.h"
+#include "archive.h"
+#include "validate.h"
+#include "profile.h"
+#include "gtp.h"
 
 int main(int argc, const char* argv[]) {
 	std::cout << "HollowNoGo-Demo: ";
@@ -26,6 +35,11 @@ int main(int argc, const char* argv[]) {
 	std::string black_args, white_args;
 	std::string load, save;
 	std::string name = "TCG-HollowNoGo-Demo", version = "2021"; // for GTP shell
+	std::string verify; // for differential verification, "random" or "mcts"
+	std::string index, query; // for the position index of the loaded records
+	std::string compress, decompress; // for the archive of records
+	std::string validate; // for the validation of records
+	std::string profile; // for the per-ply profile of the loaded and played games
 	bool summary = false, shell = false;
 	for (int i = 1; i < argc; i++) {
 		std::string para(argv[i]);
@@ -51,20 +65,135 @@ int main(int argc, const char* argv[]) {
 			summary = true;
 		} else if (para.find("--shell") == 0) {
 			shell = true;
+		} else if (para.find("--verify") == 0) {
+			verify = para.find("=") != std::string::npos ? para.substr(para.find("=") + 1) : "random";
+		} else if (para.find("--index=") == 0) {
+			index = para.substr(para.find("=") + 1);
+		} else if (para.find("--query=") == 0) {
+			query = para.substr(para.find("=") + 1);
+		} else if (para.find("--compress=") == 0) {
+			compress = para.substr(para.find("=") + 1);
+		} else if (para.find("--decompress=") == 0) {
+			decompress = para.substr(para.find("=") + 1);
+		} else if (para.find("--validate=") == 0) {
+			validate = para.substr(para.find("=") + 1);
+		} else if (para.find("--profile=") == 0) {
+			profile = para.substr(para.find("=") + 1);
+		}
+	}
+
+	if (validate.size()) { // check every move of the records, and show the rejected games
+		record_validator check;
+		if (check.validate(validate) != true) {
+			std::cerr << "cannot map " << validate << std::endl;
+			return 1;
+		}
+		for (const record_validator::failure& f : check.report()) std::cout << f << std::endl;
+		std::cout << "validated " << check.count() << " games, " << check.report().size() << " rejected" << std::endl;
+		return check.report().size() ? 1 : 0;
+	}
+
+	if (compress.size()) { // stream the records of the loaded file into an archive
+		std::ifstream in(load, std::ios::in);
+		if (!in.is_open()) {
+			std::cerr << "cannot read " << (load.size() ? load : "the records (use --load)") << std::endl;
+			return 1;
+		}
+		try {
+			archive_writer out(compress);
+			episode ep;
+			size_t skipped = 0;
+			for (std::string line; std::getline(in, line); ) {
+				if (ep.parse(line.data(), line.data() + line.size(), true)) out.write(ep);
+				else if (line.size()) skipped++;
+			}
+			out.close();
+			std::cout << "compressed " << out.size() << " games";
+			if (skipped) std::cout << ", skipped " << skipped << " unparsable lines";
+			std::cout << std::endl;
+			return skipped ? 1 : 0;
+		} catch (std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	if (decompress.size()) { // stream the records of an archive into the saved file
+		std::ofstream out(save, std::ios::out | std::ios::trunc);
+		if (!out.is_open()) {
+			std::cerr << "cannot write " << (save.size() ? save : "the records (use --save)") << std::endl;
+			return 1;
+		}
+		try {
+			archive_reader in(decompress);
+			for (size_t i = 0; i < in.blocks(); i++) {
+				for (const episode& ep : in.read(i)) out << ep << std::endl;
+			}
+			out.close();
+			std::cout << "decompressed " << in.games() << " games" << std::endl;
+			return 0;
+		} catch (std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
 		}
 	}
 
 	statistic stat(total, block, limit);
 
 	if (load.size()) {
-		std::ifstream in(load, std::ios::in);
-		in >> stat;
-		in.close();
+		if (stat.load(load) != true) { // not a regular file, read it as a stream instead
+			std::ifstream in(load, std::ios::in);
+			in >> stat;
+			in.close();
+		}
 		summary |= stat.is_finished();
 	}
 
-	MCTS_player black("name=black " + black_args + " role=black");
-	MCTS_player white("name=white " + white_args + " role=white");
+	phase_profile phases;
+	if (profile.size()) {
+		for (const episode& ep : stat) phases.add(ep);
+	}
+
+	if (index.size()) { // build the position index of the loaded records
+		size_t positions = position_index::build(stat.begin(), stat.end(), index);
+		std::cout << "indexed " << positions << " positions" << std::endl;
+		return 0;
+	}
+
+	if (query.size()) { // look up the positions given by move sequences, e.g., "E5 D5 C4"
+		position_index db(query);
+		for (std::string line; std::getline(std::cin, line); ) {
+			board state;
+			std::stringstream ss(line);
+			std::string move;
+			board::reward code = board::legal;
+			while (code == board::legal && ss >> move)
+				code = action::place(board::point(move), state.info().who_take_turns).apply(state);
+			if (code != board::legal) { // answer every line, so the answers stay in step with the queries
+				std::cout << "invalid move " << move << " (" << record_validator::reason(code) << ")" << std::endl;
+				continue;
+			}
+			auto start = std::chrono::steady_clock::now();
+			const position_index::position* pos = db.find(state);
+			auto usec = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+			size_t count = pos ? pos->count : 0, win = pos ? pos->win : 0;
+			std::cout << count << "\t" << "win = " << (count ? win * 100.0 / count : 0) << "%"
+			          << "|" << (count ? (count - win) * 100.0 / count : 0) << "%";
+			if (count) std::cout << ", first = " << db.begin(*pos)->game << "@" << db.begin(*pos)->ply;
+			std::cout << " (" << usec << " us)" << std::endl;
+		}
+		return 0;
+	}
+
+	// random games are much faster for verification, unless the search is specified
+	std::string search = verify == "random" ? "search=random " : verify == "mcts" ? "search=MCTS " : "";
+	std::unique_ptr<agent> black_agent(agent_factory::create(search + "name=black " + black_args + " role=black"));
+	std::unique_ptr<agent> white_agent(agent_factory::create(search + "name=white " + white_args + " role=white"));
+	agent& black = *black_agent;
+	agent& white = *white_agent;
+	black.warmup();
+	white.warmup();
+	verifier check;
 
 	if (!shell) { // launch standard local games
 		while (!stat.is_finished()) {
@@ -74,9 +203,17 @@ int main(int argc, const char* argv[]) {
 			stat.open_episode(black.name() + ":" + white.name());
 			episode& game = stat.back();
 			while (true) {
+				if (verify.size() && check.check(game.state()) != true) {
+					// show the first divergence and terminate
+					std::cerr << "divergence after " << game.step() << " moves" << std::endl;
+					std::cerr << check.report();
+					return 1;
+				}
 				agent& who = game.take_turns(black, white);
+				board before = game.state();
 				action move = who.take_action(game.state());
 				if (game.apply_action(move) != true) break;
+				if (profile.size()) phases.add(game.step() - 1, before, game.moves()[game.step() - 1].time(), &who);
 				if (who.check_for_win(game.state())) break;
 			}
 			agent& win = game.last_turns(black, white);
@@ -86,16 +223,15 @@ int main(int argc, const char* argv[]) {
 			white.close_episode(win.name());
 		}
 	} else { // launch GTP shell
-		for (std::string command; std::getline(std::cin, command); ) {
-			if (command.back() == '\r') command.pop_back();
-			if (command.empty()) continue;
-
-			std::vector<std::string> args;
-			std::istringstream iss(command);
-			for (std::string s; getline(iss, s, ' '); args.push_back(s));
-
+		if (black.forks() || white.forks()) { // the commands are read and run on other threads
+			std::cerr << "the GTP shell does not support processes > 1" << std::endl;
+			return 1;
+		}
+		// execute a command, where args[0] is the command name
+		auto execute = [&](const std::vector<std::string>& args) -> gtp_reply {
 			std::string reply;
 			if (args[0] == "play" || args[0] == "genmove") { // play a move, or generate a move and play
+				if (args.size() < size_t(2 + (args[0] == "play"))) return { "syntax error", false };
 				if (!stat.is_episode_ongoing()) { // should open an episode
 					black.open_episode("~:" + white.name());
 					white.open_episode(black.name() + ":~");
@@ -105,18 +241,16 @@ int main(int argc, const char* argv[]) {
 				episode& game = stat.back();
 				agent& who = game.take_turns(black, white);
 				if (who.role()[0] != std::tolower(args[1][0])) { // player mismatch?!
-					std::cout << "= " << "resign" << std::endl << std::endl;
 					// show the error message and terminate the shell
 					std::cerr << "player color " << args[1] << " mismatch!" << std::endl;
 					std::cerr << "current state, "
 					          << who.role() << " to play: " << std::endl << game.state();
-					break;
+					return { "resign", true, true };
 				}
 				if (args[0] == "play") { // play a move
 					std::string types = "?bw"; // black == 1, white == 2
 					action::place move(args[2], types.find(who.role()[0]));
 					if (game.apply_action(move) != true) { // remote plays an illegal move?!
-						std::cout << "= " << "resign" << std::endl << std::endl;
 						// show the error message and terminate the shell
 						std::cerr << who.role() << " plays an illegal action!" << std::endl;
 						const char* reason[] = {
@@ -133,7 +267,7 @@ int main(int argc, const char* argv[]) {
 						int code = move.apply(game.state());
 						std::cerr << "action: " << args[1] << " " << args[2] << std::endl;
 						std::cerr << "reason: " << reason[std::min(-code, 7)] << std::endl;
-						break;
+						return { "resign", true, true };
 					}
 				} else if (args[0] == "genmove") { // generate a move and play
 					action::place move = who.take_action(game.state());
@@ -151,7 +285,9 @@ int main(int argc, const char* argv[]) {
 					black.close_episode(win.name());
 					white.close_episode(win.name());
 				}
-				if (args[0] == "quit") break; // quit GTP shell
+				if (args[0] == "quit") return { "", true, true }; // quit GTP shell
+				black.warmup();
+				white.warmup();
 
 			} else if (args[0] == "showboard") { // print the board
 				std::stringstream buf;
@@ -159,12 +295,23 @@ int main(int argc, const char* argv[]) {
 				reply = "\n" + buf.str();
 				reply.pop_back(); // remove a new line
 
-			} else if (args[0] == "boardsize") { // set the board size
+			} else if (args[0] == "boardsize" && args.size() >= 2) { // set the board size
 				size_t size = std::stoul(args[1]);
 				if (size != board::size_x || size != board::size_y) {
 					std::cerr << "board size mismatch: " << args[1] << std::endl;
 				}
-				if (size > board::size_x || size > board::size_y) break;
+				if (size > board::size_x || size > board::size_y) return { "unacceptable size", false, true };
+
+			} else if (args[0] == "analyze" && args.size() >= 3) { // search for a while, resuming from a tree file
+				board state = stat.is_episode_ongoing() ? stat.back().state() : board();
+				agent& who = state.info().who_take_turns == board::black ? black : white;
+				MCTS_player* search = dynamic_cast<MCTS_player*>(&who);
+				if (search) {
+					action::place move = search->analyze(state, std::stof(args[1]), args[2]);
+					reply = move.position();
+				} else {
+					return { "analyze is not supported by " + who.name(), false };
+				}
 
 			} else if (args[0] == "name") { // report the name of the program
 				reply = name;
@@ -174,19 +321,77 @@ int main(int argc, const char* argv[]) {
 				reply = "2";
 			} else if (args[0] == "list_commands") { // print supported commands
 				reply = "play\n" "genmove\n" "clear_board\n" "showboard\n" "boardsize\n"
-				        "name\n" "version\n" "protocol_version\n" "list_commands\n" "quit\n";
+				        "name\n" "version\n" "protocol_version\n" "list_commands\n" "quit\n"
+				        "analyze\n";
 			} else {
-				reply = "unknown command";
+				return { "unknown command", false };
 			}
+			return reply;
+		};
 
-			std::cout << "= " << reply << std::endl << std::endl;
+		// the commands are read on another thread; genmove and analyze run in the background, during which
+		// stateless commands with ids are answered at once, and the other commands wait in order
+		gtp_reader reader(std::cin);
+		std::thread worker;
+		std::atomic<bool> done(false);
+		bool running = false, quit = false;
+		std::string running_id;
+		gtp_reply result;
+		auto finish = [&]() {
+			worker.join();
+			result.write(std::cout, running_id);
+			running = false;
+			quit |= result.terminate;
+		};
+		while (!quit) {
+			gtp_command cmd;
+			if (running && done) {
+				finish();
+			} else if (!reader.peek(cmd)) {
+				if (reader.closed()) {
+					if (!running) break;
+					finish();
+					continue;
+				}
+				std::cout.flush(); // only when idle, instead of after every response
+				reader.wait();
+			} else if (running && !(cmd.id.size() && running_id.size() && cmd.stateless())) {
+				std::cout.flush();
+				reader.wait(false); // for the running command
+			} else {
+				reader.pop();
+				if (cmd.args[0] == "genmove" || cmd.args[0] == "analyze") {
+					running = true;
+					done = false;
+					running_id = cmd.id;
+					worker = std::thread([&, cmd]() {
+						result = execute(cmd.args);
+						done = true;
+						reader.wake();
+					});
+				} else {
+					gtp_reply reply = execute(cmd.args);
+					reply.write(std::cout, cmd.id);
+					quit |= reply.terminate;
+				}
+			}
 		}
+		if (running) finish();
+		std::cout.flush();
 	}
 
 	if (summary) {
 		stat.summary();
 	}
 
+	if (profile.size() && phases.save(profile) != true) {
+		std::cerr << "cannot write " << profile << std::endl;
+	}
+
+	if (verify.size()) {
+		std::cout << "verified " << check.count() << " states, no divergence" << std::endl;
+	}
+
 	if (save.size()) {
 		std::ofstream out(save, std::ios::out | std::ios::trunc);
 		out << stat;
@@ -0,0 +1,176 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * nogo_api.cpp: C interface of the embeddable engine (libnogo)
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#include <string>
+#include <sstream>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "nogo_api.h"
+
+struct nogo_engine {
+	std::unique_ptr<MCTS_player> player[2]; // for black and white
+	board state;
+
+	std::mutex lock; // guards the fields below
+	std::condition_variable idle;
+	bool busy = false; // a search is running, or the position is being set
+	bool done = false; // the stats are of the current position
+	nogo_search_stats stats;
+
+	std::mutex worker_lock;
+	std::thread worker; // of the last asynchronous search
+
+	void acquire() {
+		std::unique_lock<std::mutex> guard(lock);
+		idle.wait(guard, [this]() { return !busy; });
+		busy = true;
+	}
+	bool try_acquire() {
+		std::lock_guard<std::mutex> guard(lock);
+		if (busy) return false;
+		busy = true;
+		return true;
+	}
+	void release() {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			busy = false;
+		}
+		idle.notify_all();
+	}
+	void join() {
+		std::lock_guard<std::mutex> guard(worker_lock);
+		if (!worker.joinable()) return;
+		if (worker.get_id() == std::this_thread::get_id()) worker.detach(); // called back from the worker
+		else worker.join();
+	}
+
+	/**
+	 * search the current position, where the engine must be acquired
+	 */
+	int search(double millisec, unsigned long long simulations, nogo_search_stats& res) {
+		std::memset(&res, 0, sizeof(res));
+		try {
+			MCTS_player& who = *player[state.info().who_take_turns == board::white ? 1 : 0];
+			MCTS_player::search_result result = who.search(state, millisec, simulations);
+			bool pass = action(result.move).type() != action::place::type;
+			res.move = pass ? -1 : result.move.position().i;
+			std::strncpy(res.name, pass ? "PASS" : std::string(result.move.position()).c_str(), sizeof(res.name) - 1);
+			res.visits = result.visits;
+			res.win_rate = result.win_rate;
+			res.millisec = result.millisec;
+		} catch (std::invalid_argument&) {
+			return NOGO_INVALID;
+		} catch (std::exception&) {
+			return NOGO_ERROR;
+		}
+		std::lock_guard<std::mutex> guard(lock);
+		stats = res;
+		done = true;
+		return NOGO_OK;
+	}
+};
+
+nogo_engine* nogo_create(const char* args) {
+	try {
+		std::unique_ptr<nogo_engine> engine(new nogo_engine);
+		std::string common = args ? args : "";
+		engine->player[0].reset(dynamic_cast<MCTS_player*>(MCTS_player::create("name=black " + common + " role=black")));
+		engine->player[1].reset(dynamic_cast<MCTS_player*>(MCTS_player::create("name=white " + common + " role=white")));
+		for (auto& player : engine->player) {
+			if (player->forks()) return nullptr; // the host and the asynchronous searches have threads of their own
+		}
+		for (auto& player : engine->player) player->warmup();
+		for (auto& player : engine->player) player->open_episode();
+		return engine.release();
+	} catch (std::exception&) {
+		return nullptr;
+	}
+}
+
+void nogo_destroy(nogo_engine* engine) {
+	if (!engine) return;
+	engine->acquire();
+	engine->join();
+	engine->release();
+	delete engine;
+}
+
+int nogo_set_position(nogo_engine* engine, const char* moves) {
+	if (!engine) return NOGO_INVALID;
+	board state;
+	std::stringstream ss(moves ? moves : "");
+	for (std::string move; ss >> move; ) {
+		if (action::place(board::point(move), state.info().who_take_turns).apply(state) != board::legal)
+			return NOGO_INVALID;
+	}
+	engine->acquire();
+	engine->state = state;
+	for (auto& player : engine->player) player->open_episode();
+	{
+		std::lock_guard<std::mutex> guard(engine->lock);
+		engine->done = false;
+	}
+	engine->release();
+	return NOGO_OK;
+}
+
+int nogo_search(nogo_engine* engine, double millisec, unsigned long long simulations, nogo_search_stats* stats) {
+	if (!engine) return NOGO_INVALID;
+	nogo_search_stats res;
+	engine->acquire();
+	int status = engine->search(millisec, simulations, res);
+	engine->release();
+	if (stats) *stats = res;
+	return status;
+}
+
+int nogo_search_async(nogo_engine* engine, double millisec, unsigned long long simulations,
+                      nogo_search_callback callback, void* user) {
+	if (!engine) return NOGO_INVALID;
+	if (!engine->try_acquire()) return NOGO_BUSY;
+	engine->join(); // the last worker may still be in its callback
+	std::lock_guard<std::mutex> guard(engine->worker_lock);
+	engine->worker = std::thread([=]() {
+		nogo_search_stats res;
+		int status = engine->search(millisec, simulations, res);
+		engine->release();
+		if (callback) callback(engine, status, &res, user);
+	});
+	return NOGO_OK;
+}
+
+int nogo_wait(nogo_engine* engine) {
+	if (!engine) return NOGO_INVALID;
+	engine->join();
+	return NOGO_OK;
+}
+
+int nogo_get_stats(nogo_engine* engine, nogo_search_stats* stats) {
+	if (!engine || !stats) return NOGO_INVALID;
+	std::lock_guard<std::mutex> guard(engine->lock);
+	if (!engine->done) return NOGO_INVALID;
+	*stats = engine->stats;
+	return NOGO_OK;
+}
+
+int nogo_best_move(nogo_engine* engine, char* name, size_t size) {
+	nogo_search_stats stats;
+	int status = nogo_get_stats(engine, &stats);
+	if (status != NOGO_OK) return status;
+	if (!name || size <= std::strlen(stats.name)) return NOGO_INVALID;
+	std::strcpy(name, stats.name);
+	return NOGO_OK;
+}
@@ -0,0 +1,97 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * nogo_api.h: C interface of the embeddable engine (libnogo)
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#ifndef NOGO_API_H
+#define NOGO_API_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * an engine is an MCTS player for each side, which searches the position set by nogo_set_position
+ * all the functions are thread-safe for the same engine; different engines are independent
+ */
+typedef struct nogo_engine nogo_engine;
+
+enum nogo_status {
+	NOGO_OK = 0,
+	NOGO_BUSY = 1, /* an asynchronous search is running */
+	NOGO_INVALID = 2, /* invalid argument, e.g., an illegal move or no budget */
+	NOGO_ERROR = 3, /* the search failed */
+};
+
+typedef struct nogo_search_stats {
+	int move; /* the best move as the index x * 9 + y, or -1 if there is no legal move */
+	char name[8]; /* the best move in GTP style, e.g., "C3", or "PASS" if there is no legal move */
+	unsigned long long visits; /* of the root, including all the search threads */
+	float win_rate; /* of the root, for the side to move */
+	float millisec; /* the time of the search */
+} nogo_search_stats;
+
+/**
+ * called on the search thread when an asynchronous search completes (with NOGO_OK or NOGO_ERROR),
+ * after the engine becomes idle; it must not call nogo_search_async, nogo_wait, or nogo_destroy on the same engine
+ */
+typedef void (*nogo_search_callback)(nogo_engine* engine, int status, const nogo_search_stats* stats, void* user);
+
+/**
+ * create an engine with the player arguments of --black and --white, e.g., "threads=4 policy=PUCT"
+ * return NULL if the arguments are invalid, or if processes > 1, since a process with other threads must not fork
+ */
+nogo_engine* nogo_create(const char* args);
+
+/**
+ * wait for the running search (if any) and destroy the engine
+ */
+void nogo_destroy(nogo_engine* engine);
+
+/**
+ * set the position by the moves from the empty board in GTP style, e.g., "C3 D4 E2", where black moves first
+ * the statistics kept between searches are cleared
+ * return NOGO_INVALID (and keep the position) if any move is illegal
+ */
+int nogo_set_position(nogo_engine* engine, const char* moves);
+
+/**
+ * search the position within the given milliseconds and simulations (0 for no limit on either, but not both),
+ * where the best move is not played; stats may be NULL
+ */
+int nogo_search(nogo_engine* engine, double millisec, unsigned long long simulations, nogo_search_stats* stats);
+
+/**
+ * start a search as nogo_search on another thread, and return immediately
+ * return NOGO_BUSY if a search is running
+ */
+int nogo_search_async(nogo_engine* engine, double millisec, unsigned long long simulations,
+                      nogo_search_callback callback, void* user);
+
+/**
+ * wait for the running asynchronous search (if any)
+ */
+int nogo_wait(nogo_engine* engine);
+
+/**
+ * get the statistics of the last completed search
+ * return NOGO_INVALID if no search has completed since the position was set
+ */
+int nogo_get_stats(nogo_engine* engine, nogo_search_stats* stats);
+
+/**
+ * get the best move of the last completed search in GTP style, e.g., "C3"
+ */
+int nogo_best_move(nogo_engine* engine, char* name, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NOGO_API_H */
@@ -0,0 +1,106 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * numa.h: NUMA topology, thread placement and memory binding
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/**
+ * the NUMA nodes of the machine, read from sysfs so that libnuma is not required
+ * a machine without the topology is treated as a single node of all the cpus
+ */
+class numa {
+public:
+	struct node {
+		int id;
+		std::vector<int> cpus;
+	};
+
+	static const std::vector<node>& nodes() { static std::vector<node> topology = detect(); return topology; }
+
+	/**
+	 * the node for the i-th search thread, where threads are scattered over the nodes
+	 */
+	static const node& node_of(size_t i) { return nodes()[i % nodes().size()]; }
+
+	/**
+	 * the cpus for the i-th search thread by the policy
+	 *  "cpu": a single cpu, i.e., the threads on the same node take its cpus in turn
+	 *  "node": all the cpus of the node
+	 */
+	static std::vector<int> cpus_of(size_t i, const std::string& policy) {
+		const node& at = node_of(i);
+		if (policy == "node") return at.cpus;
+		return { at.cpus[(i / nodes().size()) % at.cpus.size()] };
+	}
+
+	/**
+	 * pin the calling thread to the cpus
+	 */
+	static bool pin(const std::vector<int>& cpus) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu : cpus) CPU_SET(cpu, &set);
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+	}
+
+	/**
+	 * prefer the given node for the pages of a memory range that are not touched yet
+	 */
+	static bool bind(void* addr, size_t len, int id) {
+		const int mpol_preferred = 1;
+		unsigned long mask[16] = {};
+		if (id < 0 || id >= int(sizeof(mask) * 8)) return false;
+		mask[id / (sizeof(long) * 8)] = 1ul << (id % (sizeof(long) * 8));
+		return ::syscall(SYS_mbind, addr, len, mpol_preferred, mask, sizeof(mask) * 8, 0) == 0;
+	}
+
+private:
+	static std::vector<node> detect() {
+		std::vector<node> topology;
+		std::ifstream online("/sys/devices/system/node/online");
+		std::string list;
+		if (online >> list) {
+			for (int id : parse(list)) {
+				std::ifstream in("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+				std::string cpus;
+				if (in >> cpus && parse(cpus).size()) topology.push_back({ id, parse(cpus) });
+			}
+		}
+		if (topology.empty()) {
+			topology.push_back({ 0, {} });
+			for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++)
+				topology.back().cpus.push_back(cpu);
+		}
+		return topology;
+	}
+
+	/**
+	 * parse a list like "0-3,8-11"
+	 */
+	static std::vector<int> parse(const std::string& list) {
+		std::vector<int> res;
+		std::stringstream ss(list);
+		for (std::string range; std::getline(ss, range, ','); ) {
+			if (range.empty()) continue;
+			int first = std::stoi(range), last = first;
+			if (range.find('-') != std::string::npos) last = std::stoi(range.substr(range.find('-') + 1));
+			for (int i = first; i <= last; i++) res.push_back(i);
+		}
+		return res;
+	}
+};
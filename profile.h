@@ -0,0 +1,106 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * profile.h: Per-ply profile of the game phases
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "bitboard.h"
+
+/**
+ * the averages of the positions at each ply over a set of games, e.g.,
+ * the legal moves of each side (the branching factor), the exclusive points of each side (legal for it only),
+ * and the thinking time; for the moves searched by MCTS in this run, also the average playout length,
+ * the simulations per second, and the instability (how often the most visited move changes during the search)
+ */
+class phase_profile {
+public:
+	/**
+	 * add the position before the move at the given ply, the thinking time of the move,
+	 * and the search profile published by the player of the move (if any)
+	 */
+	void add(size_t ply, const board& state, time_t millisec, const agent* who = nullptr) {
+		if (rows.size() <= ply) rows.resize(ply + 1);
+		row& r = rows[ply];
+		bitboard b(state);
+		bitboard::mask black = b.legal(board::black), white = b.legal(board::white);
+		r.positions++;
+		r.legal[0] += bitboard::count(black);
+		r.legal[1] += bitboard::count(white);
+		r.exclusive[0] += bitboard::count(black & ~white);
+		r.exclusive[1] += bitboard::count(white & ~black);
+		r.millisec += millisec;
+		if (!dynamic_cast<const MCTS_player*>(who)) return; // not played by MCTS, which publishes a profile every move
+		r.searched++;
+		const char* keys[] = { "playouts", "playout_length", "sims_per_sec", "instability" };
+		for (size_t i = 0; i < 4; i++) {
+			std::string value = who->property(keys[i]);
+			if (value.empty()) continue; // not measured
+			r.search[i].sum += std::stod(value);
+			r.search[i].count++;
+		}
+	}
+
+	/**
+	 * add all the positions of a recorded game, which has no search profile
+	 */
+	void add(const episode& ep) {
+		board state;
+		size_t ply = 0;
+		for (const episode::move& mv : ep.moves()) {
+			add(ply++, state, mv.time());
+			if (action(mv).apply(state) != board::legal) break;
+		}
+	}
+
+	/**
+	 * write the profile as CSV with a row per ply, where a search column is empty if it is not measured at the ply;
+	 * the moves decided without a search (e.g., by the solver) count as searches of 0 playouts
+	 */
+	bool save(const std::string& path) const {
+		std::ofstream out(path, std::ios::out | std::ios::trunc);
+		if (!out.is_open()) return false;
+		out << "ply,positions,legal_black,legal_white,exclusive_black,exclusive_white,millisec,"
+		    << "searched,playouts,playout_length,sims_per_sec,instability" << std::endl;
+		for (size_t ply = 0; ply < rows.size(); ply++) {
+			const row& r = rows[ply];
+			if (!r.positions) continue;
+			double n = r.positions;
+			out << ply << ',' << r.positions << ','
+			    << r.legal[0] / n << ',' << r.legal[1] / n << ','
+			    << r.exclusive[0] / n << ',' << r.exclusive[1] / n << ','
+			    << r.millisec / n << ',' << r.searched;
+			for (const average& column : r.search) {
+				out << ',';
+				if (column.count) out << column.sum / column.count;
+			}
+			out << std::endl;
+		}
+		return bool(out);
+	}
+
+private:
+	struct average {
+		double sum = 0;
+		size_t count = 0;
+	};
+	struct row {
+		size_t positions = 0;
+		size_t searched = 0;
+		double legal[2] = { 0, 0 };
+		double exclusive[2] = { 0, 0 };
+		double millisec = 0;
+		average search[4]; // playouts, playout_length, sims_per_sec, and instability
+	};
+	std::vector<row> rows;
+};
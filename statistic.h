@@ -12,6 +12,13 @@
 #include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "board.h"
 #include "action.h"
 #include "agent.h"
@@ -116,6 +123,12 @@ public:
 	episode& back() {
 		return data.back();
 	}
+	std::list<episode>::const_iterator begin() const {
+		return data.begin();
+	}
+	std::list<episode>::const_iterator end() const {
+		return data.end();
+	}
 
 	friend std::ostream& operator <<(std::ostream& out, const statistic& stat) {
 		for (const episode& rec : stat.data) out << rec << std::endl;
@@ -131,6 +144,77 @@ public:
 		return in;
 	}
 
+	/**
+	 * load the records of a file, which is mapped into memory, split into line-aligned chunks,
+	 * and parsed by several threads; the records are appended in the order of the file
+	 * unlike operator >>, empty lines and lines without a record are skipped instead of ending the input
+	 * return false if the file cannot be mapped (e.g., a pipe), in which case nothing is loaded
+	 */
+	bool load(const std::string& path, size_t threads = 0) {
+		std::vector<std::list<episode>> parts;
+		bool mapped = scan(path, threads, parts, [](std::list<episode>& part, const char* line, const char* eol) {
+			part.emplace_back();
+			if (part.back().parse(line, eol) != true) part.pop_back();
+		});
+		if (mapped != true) return false;
+		for (std::list<episode>& part : parts) data.splice(data.end(), part);
+		total = std::max(total, data.size());
+		count = data.size();
+		return true;
+	}
+
+	/**
+	 * map a file into memory, split it into line-aligned chunks (at least 1 MiB each), and process the lines
+	 * of the chunks in parallel, where parts is resized to one part per chunk, and
+	 * process(part, first, last) is called for each line [first, last) of a chunk in order
+	 * return false if the file cannot be mapped (e.g., a pipe)
+	 */
+	template<typename part_type, typename function>
+	static bool scan(const std::string& path, size_t threads, std::vector<part_type>& parts, function process) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct ::stat info;
+		if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+			::close(fd);
+			return false;
+		}
+		size_t length = info.st_size;
+		void* addr = length ? ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+		::close(fd);
+		if (addr == MAP_FAILED) return false;
+		const char* text = static_cast<const char*>(addr);
+		if (length) ::madvise(addr, length, MADV_SEQUENTIAL);
+
+		const size_t chunk_min = 1 << 20; // not worth a thread below 1 MiB
+		if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = std::max<size_t>(1, std::min(threads, length / chunk_min + 1));
+		auto align = [=](size_t pos) -> size_t { // the start of the line after pos - 1
+			if (pos == 0 || pos >= length) return std::min(pos, length);
+			const void* eol = std::memchr(text + pos - 1, '\n', length - pos + 1);
+			return eol ? static_cast<const char*>(eol) - text + 1 : length;
+		};
+
+		parts.clear();
+		parts.resize(threads);
+		std::vector<std::thread> workers;
+		for (size_t i = 0; i < threads; i++) {
+			const char* first = text + align(length * i / threads);
+			const char* last = text + align(length * (i + 1) / threads);
+			part_type& part = parts[i];
+			workers.emplace_back([first, last, &part, &process]() {
+				for (const char* line = first; line < last; ) {
+					const char* eol = static_cast<const char*>(std::memchr(line, '\n', last - line));
+					if (eol == nullptr) eol = last;
+					process(part, line, eol);
+					line = eol + 1;
+				}
+			});
+		}
+		for (std::thread& worker : workers) worker.join();
+		if (length) ::munmap(addr, length);
+		return true;
+	}
+
 private:
 	size_t total;
 	size_t block;
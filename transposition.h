@@ -0,0 +1,123 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * transposition.h: Lock-free transposition table in POSIX shared memory
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <atomic>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "the shared table requires lock-free atomics");
+
+/**
+ * a hash table of search statistics shared by the processes forked after its creation
+ * entries are claimed by compare-and-swap on the key and updated by atomic additions, so no lock is taken;
+ * a key is probed at a few slots only, and an update is dropped if they are all taken by other keys
+ *
+ * the memory is a POSIX shared memory object, which is unlinked right after it is mapped,
+ * so it is released with the last process even if the processes are killed
+ *
+ * the memory may be backed by huge pages as the arena: an anonymous shared mapping of explicit huge pages
+ * (MAP_HUGETLB, also inherited by the forked processes) is tried first, then the shared memory object
+ * with transparent huge pages (MADV_HUGEPAGE), and finally normal pages
+ */
+class transposition_table {
+public:
+	struct entry {
+		std::atomic<uint64_t> key;
+		std::atomic<uint32_t> total;
+		std::atomic<uint32_t> win;
+	};
+
+	/**
+	 * create the table with the given capacity (rounded up to a power of 2), on huge pages if possible
+	 */
+	transposition_table(size_t capacity = 1 << 20, bool huge = false) : table(nullptr), size(1), length(0) {
+		while (size < capacity) size <<= 1;
+		if (huge) {
+			length = (bytes() + huge_page_size - 1) / huge_page_size * huge_page_size;
+			void* addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+			                    MAP_SHARED | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (addr != MAP_FAILED) {
+				table = static_cast<entry*>(addr);
+				return;
+			}
+		}
+		length = bytes();
+		static std::atomic<unsigned> count(0);
+		std::string name = "/nogo-tt-" + std::to_string(::getpid()) + "-" + std::to_string(count++);
+		int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd == -1) throw std::runtime_error("cannot create shared memory: " + name);
+		void* addr = MAP_FAILED;
+		if (::ftruncate(fd, length) == 0)
+			addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::shm_unlink(name.c_str());
+		::close(fd);
+		if (addr == MAP_FAILED) throw std::runtime_error("cannot map shared memory: " + name);
+		if (huge) ::madvise(addr, length, MADV_HUGEPAGE); // ignored if THP is disabled for shared memory
+		table = static_cast<entry*>(addr); // zero-filled, i.e., all empty
+	}
+	transposition_table(const transposition_table&) = delete;
+	transposition_table& operator =(const transposition_table&) = delete;
+	~transposition_table() {
+		::munmap(table, length);
+	}
+
+	/**
+	 * get the statistics of a key, or return false if the key is not in the table
+	 */
+	bool find(uint64_t key, uint32_t& total, uint32_t& win) const {
+		key |= 1; // 0 is reserved for empty slots
+		for (size_t i = key & (size - 1), n = 0; n < probes; i = (i + 1) & (size - 1), n++) {
+			uint64_t k = table[i].key.load(std::memory_order_acquire);
+			if (k == 0) return false;
+			if (k != key) continue;
+			total = table[i].total.load(std::memory_order_relaxed);
+			win = std::min(table[i].win.load(std::memory_order_relaxed), total);
+			return true;
+		}
+		return false;
+	}
+
+	/**
+	 * add a visit of a key with the given result
+	 */
+	void update(uint64_t key, int win) {
+		key |= 1;
+		for (size_t i = key & (size - 1), n = 0; n < probes; i = (i + 1) & (size - 1), n++) {
+			uint64_t k = table[i].key.load(std::memory_order_acquire);
+			if (k == 0 && table[i].key.compare_exchange_strong(k, key, std::memory_order_acq_rel)) k = key;
+			if (k != key) continue;
+			table[i].win.fetch_add(win, std::memory_order_relaxed);
+			table[i].total.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+
+	/**
+	 * remove all the entries, which must not be used by any other process meanwhile
+	 */
+	void clear() {
+		std::memset(static_cast<void*>(table), 0, bytes());
+	}
+
+private:
+	size_t bytes() const { return size * sizeof(entry); }
+
+private:
+	static constexpr size_t probes = 16;
+	static constexpr size_t huge_page_size = 2 << 20;
+	entry* table;
+	size_t size;
+	size_t length; // of the mapping, which is rounded up to huge pages
+};
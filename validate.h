@@ -0,0 +1,119 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * validate.h: Parallel validation of game records
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include "board.h"
+#include "action.h"
+#include "bitboard.h"
+#include "episode.h"
+#include "statistic.h"
+
+/**
+ * check every move of every record in a file with the rules of board::place (by bitboard, which follows them exactly)
+ * the file is scanned by statistic::scan, so the records are parsed and replayed on all the cores
+ */
+class record_validator {
+public:
+	struct failure {
+		size_t game; // the index of the record from 1, where empty lines are not counted
+		size_t ply; // the number of moves before the failed move, or -1 for a record that cannot be parsed
+		std::string move; // as written in the record, e.g., ";W[zz]"
+		board::reward code; // a nogo_move_result, or corrupt
+	};
+	static constexpr board::reward corrupt = board::reward(-100);
+
+	record_validator() : games(0) {}
+
+	/**
+	 * validate the records of a file, and return false if it cannot be mapped
+	 * the failures are kept in the order of the file
+	 */
+	bool validate(const std::string& path, size_t threads = 0) {
+		struct part {
+			size_t games = 0;
+			std::vector<failure> failures;
+		};
+		std::vector<part> parts;
+		bool mapped = statistic::scan(path, threads, parts, [](part& chunk, const char* line, const char* eol) {
+			if (line == eol) return; // empty line
+			size_t game = ++chunk.games;
+			episode ep;
+			if (ep.parse(line, eol, true) != true) {
+				chunk.failures.push_back({ game, size_t(-1), {}, corrupt });
+				return;
+			}
+			bitboard state;
+			size_t ply = 0;
+			for (const episode::move& mv : ep.moves()) {
+				action::place move(mv);
+				board::reward code = action(mv).type() == action::place::type
+					? state.place(move.position(), move.color()) : corrupt;
+				if (code != board::legal) {
+					chunk.failures.push_back({ game, ply, token(line, eol, ply), code });
+					return;
+				}
+				ply++;
+			}
+		});
+		if (mapped != true) return false;
+		for (part& chunk : parts) {
+			for (failure& f : chunk.failures) {
+				f.game += games;
+				failures.push_back(f);
+			}
+			games += chunk.games;
+		}
+		return true;
+	}
+
+	/**
+	 * the text of the given move of a record that has been parsed strictly, i.e., from its ';' to the next ';' or ')'
+	 */
+	static std::string token(const char* line, const char* eol, size_t ply) {
+		const char* head = "C[TCG|";
+		const char* at = std::search(line, eol, head, head + 6);
+		for (size_t i = 0; i <= ply && at != eol; i++) at = std::find(at + 1, eol, ';');
+		const char* end = std::find_if(at + (at != eol), eol, [](char c) { return c == ';' || c == ')'; });
+		return std::string(at, end);
+	}
+
+	size_t count() const { return games; }
+	const std::vector<failure>& report() const { return failures; }
+
+	static const char* reason(board::reward code) {
+		switch (code) {
+		case board::legal:                return "legal";
+		case board::illegal_turn:         return "illegal_turn";
+		case board::illegal_pass:         return "illegal_pass";
+		case board::illegal_out_of_range: return "illegal_out_of_range";
+		case board::illegal_not_empty:    return "illegal_not_empty";
+		case board::illegal_suicide:      return "illegal_suicide";
+		case board::illegal_take:         return "illegal_take";
+		case board::illegal_same_color:   return "illegal_same_color";
+		case corrupt:                     return "corrupt";
+		default:                          return "unknown";
+		}
+	}
+
+	friend std::ostream& operator <<(std::ostream& out, const failure& f) {
+		out << "game " << f.game;
+		if (f.ply == size_t(-1)) return out << ": " << reason(f.code) << " record";
+		out << ", move " << (f.ply + 1) << ": ";
+		if (f.move.size()) out << f.move << ' ';
+		return out << reason(f.code) << " (" << f.code << ")";
+	}
+
+private:
+	size_t games;
+	std::vector<failure> failures;
+};
@@ -0,0 +1,106 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * verify.h: Differential verification between the reference board and the bitboard
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <sstream>
+#include "board.h"
+#include "bitboard.h"
+
+/**
+ * compare board and bitboard on a given state
+ *
+ * for both sides and every point (including PASS), the following must agree
+ *  - the nogo_move_result code of placing there, and the resulting state if legal
+ *  - the set of legal moves
+ *  - whether the block at the point belongs to the side, and whether it has any liberty
+ *    (board::check_liberty counts a point with multiplicity, so only zero-ness is comparable)
+ */
+class verifier {
+public:
+	verifier() : checked(0) {}
+
+	/**
+	 * return true if both engines agree on the state, otherwise save the first divergence in report()
+	 */
+	bool check(const board& state) {
+		checked++;
+		std::stringstream buf;
+		bitboard fast(state);
+		if (board(fast) != state || fast.take_turns() != state.info().who_take_turns) {
+			buf << "conversion mismatch" << std::endl;
+			return fail(state, buf);
+		}
+
+		unsigned opp = 3u - state.info().who_take_turns;
+		board ref_turn = state;
+		bitboard fast_turn = fast;
+		board::reward ref_code = ref_turn.place(0, 0, opp), fast_code = fast_turn.place(0, 0, opp);
+		if (ref_code != fast_code) {
+			buf << "place " << board::point(0, 0) << " by " << opp << " out of turn: "
+			    << "board = " << ref_code << ", bitboard = " << fast_code << std::endl;
+			return fail(state, buf);
+		}
+
+		for (unsigned who = board::black; who <= board::white; who++) {
+			bitboard::mask ref_legal = 0;
+			for (int i = -1; i < board::size_x * board::size_y; i++) {
+				board::point p(i);
+				board ref = state;
+				ref.info({static_cast<board::piece_type>(who)});
+				bitboard fst = fast;
+				fst.take_turns(static_cast<board::piece_type>(who));
+				ref_code = ref.place(p, who);
+				fast_code = fst.place(p, who);
+				if (ref_code != fast_code || (ref_code == board::legal && (board(fst) != ref
+				        || fst.take_turns() != ref.info().who_take_turns))) {
+					buf << "place " << p << " by " << who << ": "
+					    << "board = " << ref_code << ", bitboard = " << fast_code << std::endl;
+					return fail(state, buf);
+				}
+				if (i == -1) continue;
+				if (ref_code == board::legal) ref_legal |= bitboard::bit(i);
+
+				int ref_lib = state.check_liberty(p.x, p.y, who);
+				int fast_lib = fast.check_liberty(p.x, p.y, who);
+				if ((ref_lib < 0) != (fast_lib < 0) || (ref_lib == 0) != (fast_lib == 0)) {
+					buf << "liberty of " << p << " by " << who << ": "
+					    << "board = " << ref_lib << ", bitboard = " << fast_lib << std::endl;
+					return fail(state, buf);
+				}
+			}
+			bitboard::mask fast_legal = fast.legal(who);
+			if (ref_legal != fast_legal) {
+				buf << "legal moves by " << who << ":";
+				for (bitboard::mask diff = ref_legal ^ fast_legal; diff; diff &= diff - 1) {
+					int i = bitboard::lowest(diff);
+					buf << ' ' << board::point(i) << (ref_legal & bitboard::bit(i) ? "(board)" : "(bitboard)");
+				}
+				buf << std::endl;
+				return fail(state, buf);
+			}
+		}
+		return true;
+	}
+
+	size_t count() const { return checked; }
+	const std::string& report() const { return divergence; }
+
+private:
+	bool fail(const board& state, std::stringstream& buf) {
+		buf << "state #" << checked << ", " << "?bw"[state.info().who_take_turns & 0b11]
+		    << " to play: " << std::endl << state;
+		divergence = buf.str();
+		return false;
+	}
+
+private:
+	size_t checked;
+	std::string divergence;
+};